@@ -0,0 +1,300 @@
+#pragma once
+
+#include <8Beat/WaveformGeneration.h>
+#include <8Beat/EffectChain.h>
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+namespace beat
+{
+
+  void waveform_generation_unit_tests()
+  {
+    WaveformGeneration wave_gen;
+    WaveformGenerationParams params;
+    params.freq_vibrato_depth = 0.2f;
+    params.freq_vibrato_freq = 5.f;
+    params.arpeggio = { { 0.1f, 1.5f }, { 0.2f, 2.f } };
+    
+    const float duration = 0.3f;
+    const int sample_rate = 8000;
+    
+    // Specialized kernel vs. per-sample custom callbacks.
+    auto wave_kernel = wave_gen.generate_waveform(WaveformType::SINE, duration, 440.f, params, sample_rate,
+                                                  false, FrequencyType::CHIRP_1, AmplitudeType::VIBRATO_0);
+    
+    WaveformGeneration::WaveformFunc sine = [](float phi, float)
+    {
+      return std::sin(phi);
+    };
+    WaveformGeneration::FrequencyFunc chirp_1 = [](float t, float, float freq_0)
+    {
+      return freq_0 + 1.5f*t;
+    };
+    WaveformGeneration::AmplitudeFunc vibrato_0 = [](float t, float)
+    {
+      return 0.8f + 0.2f*std::sin(math::c_2pi * 2.2f*t*(1 + std::min(0.8f, 0.4f*t)));
+    };
+    auto wave_sample = wave_gen.generate_waveform(sine, duration, 440.f, params, sample_rate,
+                                                  false, chirp_1, vibrato_0);
+    
+    // Block custom callbacks.
+    WaveformGeneration::WaveformBlockFunc sine_block =
+      [](std::span<const float> phi, std::span<const float>, std::span<float> out)
+    {
+      for (size_t i = 0; i < out.size(); ++i)
+        out[i] = std::sin(phi[i]);
+    };
+    WaveformGeneration::FrequencyBlockFunc chirp_1_block =
+      [](std::span<const float> t, float, float freq_0, std::span<float> out)
+    {
+      for (size_t i = 0; i < out.size(); ++i)
+        out[i] = freq_0 + 1.5f*t[i];
+    };
+    WaveformGeneration::AmplitudeBlockFunc vibrato_0_block =
+      [&vibrato_0](std::span<const float> t, float duration, std::span<float> out)
+    {
+      for (size_t i = 0; i < out.size(); ++i)
+        out[i] = vibrato_0(t[i], duration);
+    };
+    auto wave_block = wave_gen.generate_waveform(sine_block, duration, 440.f, params, sample_rate,
+                                                 false, chirp_1_block, vibrato_0_block);
+    
+    std::cout << "Waveform lengths: " << wave_kernel.buffer.size() << ", "
+      << wave_sample.buffer.size() << ", " << wave_block.buffer.size() << std::endl;
+    assert(wave_kernel.buffer.size() == static_cast<size_t>(duration * sample_rate));
+    assert(wave_kernel.buffer == wave_sample.buffer);
+    assert(wave_kernel.buffer == wave_block.buffer);
+    
+    // Control-rate modulation should stay close to audio-rate modulation.
+    WaveformGenerationParams params_cr;
+    params_cr.freq_slide_vel = 1.f;
+    params_cr.freq_slide_acc = -0.5f;
+    params_cr.vibrato_depth = 0.3f;
+    params_cr.vibrato_freq = 6.f;
+    params_cr.duty_cycle_sweep = 0.5f;
+    auto wave_ar = wave_gen.generate_waveform(WaveformType::TRIANGLE, duration, 220.f, params_cr, sample_rate);
+    params_cr.control_rate = 32;
+    auto wave_cr = wave_gen.generate_waveform(WaveformType::TRIANGLE, duration, 220.f, params_cr, sample_rate);
+    float max_diff = 0.f;
+    for (size_t i = 0; i < wave_ar.buffer.size(); ++i)
+      math::maximize(max_diff, std::abs(wave_ar.buffer[i] - wave_cr.buffer[i]));
+    std::cout << "Control-rate max diff: " << max_diff << std::endl;
+    assert(max_diff < 1e-2f);
+    
+    // Compiled params.
+    WaveformGenerationParams params_arp;
+    params_arp.arpeggio = { { 0.2f, 2.f }, { 0.1f, 1.5f } };
+    CompiledWaveformGenerationParams params_arp_compiled(params_arp);
+    assert(params_arp_compiled.arpeggio.size() == 3);
+    assert(params_arp_compiled.arpeggio[0].time == 0.f);
+    assert(params_arp_compiled.arpeggio[1].time == 0.1f);
+    assert(params_arp_compiled.arpeggio[2].time == 0.2f);
+    auto wave_arp = wave_gen.generate_waveform(WaveformType::SAWTOOTH, duration, 330.f, params_arp, sample_rate);
+    auto wave_arp_compiled = wave_gen.generate_waveform(WaveformType::SAWTOOTH, duration, 330.f, params_arp_compiled, sample_rate);
+    assert(wave_arp.buffer == wave_arp_compiled.buffer);
+    
+    // Filtered noise: the filter state carries over between slots so there is no slot delay.
+    WaveformGenerationParams params_noise;
+    params_noise.noise_filter_slot_dur_s = 1e-3f;
+    params_noise.freq_slide_vel = 2.f;
+    auto wave_noise = wave_gen.generate_waveform(WaveformType::NOISE, duration, 500.f, params_noise, sample_rate);
+    for (auto s : wave_noise.buffer)
+      assert(std::isfinite(s) && std::abs(s) <= 1.f);
+    assert(wave_noise.buffer[1] != 0.f);
+    
+    // Seeded PRNG: fill() gives the same sequence as rand_float().
+    PRNG prng_a(1234);
+    PRNG prng_b(1234);
+    std::vector<float> rnd_fill(37);
+    prng_a.rand();
+    prng_a.fill(rnd_fill, -1.f, +1.f);
+    prng_b.rand();
+    for (auto r : rnd_fill)
+      assert(r == prng_b.rand_float(-1.f, +1.f) && -1.f <= r && r < 1.f);
+    
+    // Seeded renders are reproducible.
+    WaveformGenerationParams params_seed;
+    params_seed.seed = 42;
+    auto wave_seed_0 = wave_gen.generate_waveform(WaveformType::NOISE, duration, std::nullopt, params_seed, sample_rate,
+                                                  false, FrequencyType::JET_ENGINE_POWERUP, AmplitudeType::JET_ENGINE_POWERUP);
+    auto wave_seed_1 = wave_gen.generate_waveform(WaveformType::NOISE, duration, std::nullopt, params_seed, sample_rate,
+                                                  false, FrequencyType::JET_ENGINE_POWERUP, AmplitudeType::JET_ENGINE_POWERUP);
+    assert(wave_seed_0.buffer == wave_seed_1.buffer);
+    WaveformGeneration::PhaseFunc phase_zero = [](float, float) { return 0.f; };
+    auto wave_seed_generic = wave_gen.generate_waveform(WaveformType::NOISE, duration, std::nullopt, params_seed, sample_rate,
+                                                        false, FrequencyType::JET_ENGINE_POWERUP, AmplitudeType::JET_ENGINE_POWERUP,
+                                                        phase_zero);
+    assert(wave_seed_0.buffer == wave_seed_generic.buffer);
+    params_seed.seed = 43;
+    auto wave_seed_2 = wave_gen.generate_waveform(WaveformType::NOISE, duration, std::nullopt, params_seed, sample_rate,
+                                                  false, FrequencyType::JET_ENGINE_POWERUP, AmplitudeType::JET_ENGINE_POWERUP);
+    assert(wave_seed_0.buffer != wave_seed_2.buffer);
+    
+    // Oscillator rendered in chunks matches generate_waveform().
+    auto f_render_chunks = [](Oscillator& osc, size_t num_samples)
+    {
+      std::vector<float> buffer(num_samples);
+      size_t chunk_sizes[] = { 1, 37, 100, 513 };
+      size_t offs = 0;
+      for (int c = 0; offs < num_samples; ++c)
+      {
+        auto n = std::min(chunk_sizes[c % 4], num_samples - offs);
+        osc.render(std::span<float>(buffer.data() + offs, n));
+        offs += n;
+      }
+      return buffer;
+    };
+    params_cr.arpeggio = { { 0.05f, 1.5f } };
+    auto wave_osc_ref = wave_gen.generate_waveform(WaveformType::SQUARE, duration, 220.f, params_cr, sample_rate,
+                                                   false, FrequencyType::CHIRP_0, AmplitudeType::VIBRATO_0);
+    Oscillator osc(WaveformType::SQUARE, duration, 220.f, params_cr, sample_rate,
+                   FrequencyType::CHIRP_0, AmplitudeType::VIBRATO_0);
+    assert(f_render_chunks(osc, wave_osc_ref.buffer.size()) == wave_osc_ref.buffer);
+    osc.reset();
+    assert(osc.get_time() == 0.f);
+    assert(f_render_chunks(osc, wave_osc_ref.buffer.size()) == wave_osc_ref.buffer);
+    Oscillator osc_generic(sine_block, duration, 440.f, params, sample_rate, chirp_1, vibrato_0_block);
+    assert(f_render_chunks(osc_generic, wave_kernel.buffer.size()) == wave_kernel.buffer);
+    // The phase of a long tone stays accurate, via the kernel and via the generic path.
+    {
+      WaveformGeneration::WaveformFunc sine_func = [](float phi, float) { return std::sin(phi); };
+      Oscillator osc_long(WaveformType::SINE, 60.f, 997.f, WaveformGenerationParams {}, sample_rate);
+      Oscillator osc_long_generic(sine_func, 60.f, 997.f, WaveformGenerationParams {}, sample_rate);
+      std::vector<float> chunk(4410);
+      std::vector<float> chunk_generic(4410);
+      int64_t n = 0;
+      float max_err = 0.f;
+      for (int c = 0; c < 600; ++c)
+      {
+        osc_long.render(chunk);
+        osc_long_generic.render(chunk_generic);
+        for (size_t k = 0; k < chunk.size(); ++k)
+        {
+          ++n;
+          auto ref = static_cast<float>(std::sin(math::c_2pi * std::fmod(997. * n, sample_rate) / sample_rate));
+          max_err = std::max({ max_err, std::abs(chunk[k] - ref), std::abs(chunk_generic[k] - ref) });
+        }
+      }
+      assert(max_err < 1e-5f);
+    }
+    
+    auto wave_ks_0 = WaveformHelper::karplus_strong(0.1f, 440.f, sample_rate, 7);
+    auto wave_ks_1 = WaveformHelper::karplus_strong(0.1f, 440.f, sample_rate, 7);
+    assert(wave_ks_0.buffer == wave_ks_1.buffer);
+    
+    // Wavetable mode.
+    WaveformGenerationParams params_wt;
+    params_wt.wavetable = wave_gen.create_wavetable(WaveformType::SINE);
+    auto wave_wt = wave_gen.generate_waveform(WaveformType::SQUARE, duration, 440.f, params_wt, sample_rate);
+    auto wave_sine = wave_gen.generate_waveform(WaveformType::SINE, duration, 440.f, {}, sample_rate);
+    for (size_t i = 0; i < wave_wt.buffer.size(); ++i)
+      assert(std::abs(wave_wt.buffer[i] - wave_sine.buffer[i]) < 1e-3f);
+    params_wt.wavetable = wave_gen.create_wavetable(sine);
+    auto wave_wt_generic = wave_gen.generate_waveform(sine, duration, 440.f, params_wt, sample_rate);
+    assert(wave_wt_generic.buffer == wave_wt.buffer);
+    // Expected to print an "ERROR in create_wavetable()" line.
+    assert(wave_gen.create_wavetable(WaveformType::NOISE) == nullptr);
+    assert(Wavetable::select_level(1.f, sample_rate) == 0);
+    assert(Wavetable::select_level(4.f * sample_rate / Wavetable::c_table_size, sample_rate) == 2);
+    assert(Wavetable::select_level(3000.f, sample_rate) == Wavetable::c_num_levels - 1);
+    // Only the fundamental is left at the top level.
+    auto square_wt = wave_gen.create_wavetable(WaveformType::SQUARE);
+    auto top_level = square_wt->get_level(Wavetable::c_num_levels - 1);
+    for (int i = 0; i < Wavetable::c_table_size; ++i)
+      assert(std::abs(top_level[i] - 4.f/math::c_pi*std::sin(math::c_2pi*i/Wavetable::c_table_size)) < 1e-2f);
+    
+    // PolyBLEP. The 13th harmonic of a 3 kHz square aliases to 5.1 kHz at 44.1 kHz.
+    auto f_magnitude_at = [](const Waveform& wave, float freq)
+    {
+      double re = 0., im = 0.;
+      for (size_t i = 0; i < wave.buffer.size(); ++i)
+      {
+        double w = math::c_2pi * freq * i / wave.sample_rate;
+        re += wave.buffer[i] * std::cos(w);
+        im += wave.buffer[i] * std::sin(w);
+      }
+      return std::sqrt(re*re + im*im) / wave.buffer.size();
+    };
+    WaveformGenerationParams params_bl;
+    params_bl.band_limited = true;
+    for (auto wave_type : { WaveformType::SQUARE, WaveformType::TRIANGLE, WaveformType::SAWTOOTH })
+    {
+      auto wave_naive = wave_gen.generate_waveform(wave_type, 0.1f, 3000.f);
+      auto wave_bl = wave_gen.generate_waveform(wave_type, 0.1f, 3000.f, params_bl);
+      auto alias_naive = f_magnitude_at(wave_naive, 5100.f);
+      auto alias_bl = f_magnitude_at(wave_bl, 5100.f);
+      std::cout << "PolyBLEP alias magnitude: " << alias_naive << " -> " << alias_bl << std::endl;
+      assert(alias_bl < 0.5 * alias_naive);
+    }
+    params_bl.duty_cycle = 0.3f;
+    params_bl.duty_cycle_sweep = 0.5f;
+    auto wave_bl_kernel = wave_gen.generate_waveform(WaveformType::SAWTOOTH, duration, 440.f, params_bl, sample_rate,
+                                                     false, FrequencyType::CHIRP_1);
+    auto wave_bl_generic = wave_gen.generate_waveform(WaveformType::SAWTOOTH, duration, 440.f, params_bl, sample_rate,
+                                                      false, chirp_1);
+    assert(wave_bl_kernel.buffer == wave_bl_generic.buffer);
+    
+    // FastMath.
+    std::vector<float> fm_x, fm_out;
+    for (int i = 0; i < 20003; ++i)
+      fm_x.emplace_back(-80.f + 0.008f*i);
+    fm_out.resize(fm_x.size());
+    FastMath::sin(fm_x, fm_out);
+    for (size_t i = 0; i < fm_x.size(); ++i)
+    {
+      assert(std::abs(fm_out[i] - std::sin(fm_x[i])) < 1e-6f);
+      assert(std::abs(FastMath::sin(fm_x[i]) - fm_out[i]) < 1e-6f);
+    }
+    FastMath::exp(fm_x, fm_out);
+    for (size_t i = 0; i < fm_x.size(); ++i)
+      assert(std::abs(fm_out[i] - std::exp(fm_x[i])) <= 1e-6f*std::exp(fm_x[i]));
+    for (auto& x : fm_x)
+      x = std::abs(x) + 1e-3f;
+    FastMath::log(fm_x, fm_out);
+    for (size_t i = 0; i < fm_x.size(); ++i)
+      assert(std::abs(fm_out[i] - std::log(fm_x[i])) < 1e-6f*std::max(1.f, std::abs(std::log(fm_x[i]))));
+    assert(std::isinf(FastMath::log(0.f)) && std::isnan(FastMath::log(-1.f)));
+    
+    WaveformGenerationParams params_fast = params;
+    params_fast.math_policy = MathPolicy::FAST;
+    auto wave_fast = wave_gen.generate_waveform(WaveformType::SINE, duration, 440.f, params_fast, sample_rate,
+                                                false, FrequencyType::CHIRP_1, AmplitudeType::VIBRATO_0);
+    for (size_t i = 0; i < wave_fast.buffer.size(); ++i)
+      assert(std::abs(wave_fast.buffer[i] - wave_kernel.buffer[i]) < 1e-4f);
+    auto wave_fast_kernel = wave_gen.generate_waveform(WaveformType::SINE, duration, 440.f, params_fast, sample_rate,
+                                                       false, FrequencyType::CHIRP_1);
+    auto wave_fast_generic = wave_gen.generate_waveform(WaveformType::SINE, duration, 440.f, params_fast, sample_rate,
+                                                        false, chirp_1);
+    assert(wave_fast_kernel.buffer == wave_fast_generic.buffer);
+    
+    // Fused effect chain vs the stages one at a time over the whole buffer.
+    FilterArgs chain_flt { FilterType::Butterworth, FilterOpType::LowPass, 2, 1.5f };
+    ADSR chain_adsr { { ADSRMode::EXP, 20 }, { ADSRMode::LOG, 50 }, { 0.6f }, { ADSRMode::EXP, 100 } };
+    auto wave_chain_ref = wave_gen.generate_waveform(WaveformType::SAWTOOTH, duration, 330.f, params, sample_rate);
+    auto wave_mod = wave_gen.generate_waveform(WaveformType::SINE, duration, 55.f, {}, sample_rate);
+    WaveformHelper::apply_filter(wave_chain_ref, chain_flt);
+    WaveformHelper::apply_envelope_adsr(wave_chain_ref.buffer, chain_adsr, duration, sample_rate);
+    WaveformHelper::scale(wave_chain_ref, 0.5f);
+    WaveformHelper::apply_ring_modulation(wave_chain_ref.buffer, wave_mod.buffer);
+    EffectChain chain;
+    chain.add_generator(Oscillator(WaveformType::SAWTOOTH, duration, 330.f, params, sample_rate))
+         .add_filter(WaveformHelper::design_filter_sos(chain_flt, 330.f, sample_rate))
+         .add_clamp()
+         .add_envelope(EnvelopeGenerator(chain_adsr, duration, sample_rate, wave_chain_ref.buffer.size()))
+         .add_gain(0.5f)
+         .add_ring_mod(Oscillator(WaveformType::SINE, duration, 55.f, WaveformGenerationParams {}, sample_rate));
+    assert(chain.num_stages() == 6);
+    std::vector<float> wave_chain(wave_chain_ref.buffer.size());
+    chain.process(std::span<float>(wave_chain).first(1000));
+    chain.process(std::span<float>(wave_chain).subspan(1000));
+    assert(wave_chain == wave_chain_ref.buffer);
+    chain.reset();
+    std::vector<float> wave_chain_2(wave_chain.size());
+    chain.process(wave_chain_2);
+    assert(wave_chain_2 == wave_chain);
+  }
+
+}
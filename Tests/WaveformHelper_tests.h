@@ -48,6 +48,380 @@ namespace beat
     assert(butter.a[1] - (-0.739251f) < 1e-6f);
     assert(butter.b.size() == 1);
     assert(butter.b[0] - (0.130375f) < 1e-6f);
+    
+    // FFT vs. DFT, for both odd and even log2 sizes, mixed-radix sizes and Bluestein sizes.
+    for (int Nf : { 8, 16, 32, 12, 30, 42, 22, 26 })
+    {
+      Waveform wave_f(Nf, 0.f);
+      for (int i = 0; i < Nf; ++i)
+        wave_f.buffer[i] = std::sin(0.37f*i) + 0.3f*std::cos(1.9f*i*i);
+      auto spectrum = WaveformHelper::fft(wave_f);
+      assert(static_cast<int>(spectrum.buffer.size()) == Nf);
+      for (int m = 0; m < Nf; ++m)
+      {
+        std::complex<double> dft = 0.;
+        for (int i = 0; i < Nf; ++i)
+          dft += static_cast<double>(wave_f.buffer[i]) * std::polar(1., -2.*math::cd_pi*m*i/Nf);
+        assert(std::abs(std::complex<double>(spectrum.buffer[m]) - dft) < 1e-4);
+      }
+      auto wave_f_rt = WaveformHelper::ifft(spectrum);
+      for (int i = 0; i < Nf; ++i)
+        assert(std::abs(wave_f_rt.buffer[i] - wave_f.buffer[i]) < 1e-5f);
+      
+      // Real-input FFT: the non-negative frequency bins of the full spectrum.
+      auto half_spectrum = WaveformHelper::fft(wave_f, true);
+      assert(half_spectrum.half_spectrum);
+      assert(static_cast<int>(half_spectrum.buffer.size()) == Nf/2 + 1);
+      assert(static_cast<int>(half_spectrum.signal_length()) == Nf);
+      for (int m = 0; m <= Nf/2; ++m)
+        assert(std::abs(half_spectrum.buffer[m] - spectrum.buffer[m]) < 1e-4f);
+      auto wave_f_half_rt = WaveformHelper::ifft(half_spectrum);
+      assert(static_cast<int>(wave_f_half_rt.buffer.size()) == Nf);
+      for (int i = 0; i < Nf; ++i)
+        assert(std::abs(wave_f_half_rt.buffer[i] - wave_f.buffer[i]) < 1e-5f);
+    }
+    assert(FFTPlan::next_fast_size(131073) == 131220);
+    assert(FFTPlan::next_fast_size(11) == 12);
+    
+    // Fast (FFT) vs. direct convolution.
+    {
+      Waveform wave_r(300, 0.f);
+      Waveform kernel_r(137, 0.f);
+      for (int i = 0; i < 300; ++i)
+        wave_r.buffer[i] = std::sin(0.1f*i);
+      for (int i = 0; i < 137; ++i)
+        kernel_r.buffer[i] = std::exp(-0.01f*i)*std::cos(0.3f*i);
+      std::vector<float> conv_direct(wave_r.buffer.size() + kernel_r.buffer.size() - 1, 0.f);
+      for (size_t i = 0; i < wave_r.buffer.size(); ++i)
+        for (size_t j = 0; j < kernel_r.buffer.size(); ++j)
+          conv_direct[i + j] += wave_r.buffer[i] * kernel_r.buffer[j];
+      auto reverb_direct = WaveformHelper::reverb(wave_r, kernel_r);
+      assert(reverb_direct.buffer.size() == conv_direct.size());
+      
+      // reverb() takes the direct path for these sizes, so go through FFTPlan explicitly.
+      const int Nc = 2 * FFTPlan::next_fast_size(static_cast<int>(conv_direct.size() + 1) / 2);
+      auto& plan_c = FFTPlan::get(Nc);
+      std::vector<float> xx(Nc, 0.f);
+      std::vector<float> kk(Nc, 0.f);
+      std::copy(wave_r.buffer.begin(), wave_r.buffer.end(), xx.begin());
+      std::copy(kernel_r.buffer.begin(), kernel_r.buffer.end(), kk.begin());
+      std::vector<std::complex<float>> spec_x(Nc/2 + 1);
+      std::vector<std::complex<float>> spec_k(Nc/2 + 1);
+      plan_c.forward_real(xx, spec_x);
+      plan_c.forward_real(kk, spec_k);
+      for (int m = 0; m <= Nc/2; ++m)
+        spec_x[m] *= spec_k[m] / static_cast<float>(Nc);
+      plan_c.inverse_real(spec_x, xx);
+      for (size_t i = 0; i < conv_direct.size(); ++i)
+        assert(std::abs(xx[i] - conv_direct[i]) < 1e-5f);
+      
+      // Partitioned convolution, offline and streamed in uneven chunks.
+      auto reverb_part = WaveformHelper::reverb_fast(wave_r, kernel_r, 32);
+      assert(reverb_part.buffer.size() == reverb_direct.buffer.size());
+      for (size_t i = 0; i < reverb_direct.buffer.size(); ++i)
+        assert(std::abs(reverb_part.buffer[i] - reverb_direct.buffer[i]) < 1e-5f);
+      
+      Convolver convolver(kernel_r.buffer, 48);
+      std::vector<float> stream_in = wave_r.buffer;
+      stream_in.resize(conv_direct.size() + convolver.latency(), 0.f);
+      std::vector<float> stream_out(stream_in.size(), 0.f);
+      size_t pos = 0;
+      for (size_t chunk = 1; pos < stream_in.size(); chunk = chunk * 3 % 71 + 1)
+      {
+        auto n = std::min(chunk, stream_in.size() - pos);
+        convolver.process(std::span { stream_in }.subspan(pos, n), std::span { stream_out }.subspan(pos, n));
+        pos += n;
+      }
+      for (size_t i = 0; i < conv_direct.size(); ++i)
+        assert(std::abs(stream_out[i + convolver.latency()] - conv_direct[i]) < 1e-5f);
+      
+      // SIMD direct convolution.
+      auto conv_simd = Convolver::convolve_direct(wave_r.buffer, kernel_r.buffer);
+      assert(conv_simd.size() == conv_direct.size());
+      for (size_t i = 0; i < conv_direct.size(); ++i)
+        assert(std::abs(conv_simd[i] - conv_direct[i]) < 1e-5f);
+      
+      // Direct for short kernels and FFT for long ones.
+      assert(Convolver::prefer_direct(48000, 16));
+      assert(!Convolver::prefer_direct(48000, 48000));
+      Waveform wave_long(5000, 0.f);
+      Waveform kernel_long(5000, 0.f);
+      for (int i = 0; i < 5000; ++i)
+      {
+        wave_long.buffer[i] = std::sin(0.1f*i);
+        kernel_long.buffer[i] = 0.01f*std::exp(-0.001f*i)*std::cos(0.3f*i);
+      }
+      assert(!Convolver::prefer_direct(wave_long.buffer.size(), kernel_long.buffer.size()));
+      auto reverb_long = WaveformHelper::reverb_fast(wave_long, kernel_long);
+      auto conv_long = Convolver::convolve_direct(wave_long.buffer, kernel_long.buffer);
+      assert(reverb_long.buffer.size() == conv_long.size());
+      for (size_t i = 0; i < conv_long.size(); ++i)
+        assert(std::abs(reverb_long.buffer[i] - conv_long[i]) < 1e-5f);
+      
+      // Precomputed impulse response, mono and mono wave with stereo IR.
+      ImpulseResponse ir(kernel_r, 64);
+      auto reverb_ir = WaveformHelper::reverb(wave_r, ir);
+      assert(reverb_ir.buffer.size() == reverb_direct.buffer.size());
+      for (size_t i = 0; i < reverb_direct.buffer.size(); ++i)
+        assert(std::abs(reverb_ir.buffer[i] - reverb_direct.buffer[i]) < 1e-5f);
+      
+      Waveform kernel_r_neg = kernel_r;
+      for (auto& s : kernel_r_neg.buffer)
+        s = -s;
+      ImpulseResponse ir_stereo({ kernel_r, kernel_r_neg }, 64);
+      assert(ir_stereo.num_channels() == 2);
+      auto reverb_ir_stereo = WaveformHelper::reverb(std::vector<Waveform> { wave_r }, ir_stereo);
+      assert(reverb_ir_stereo.size() == 2);
+      for (size_t i = 0; i < reverb_direct.buffer.size(); ++i)
+      {
+        assert(std::abs(reverb_ir_stereo[0].buffer[i] - reverb_direct.buffer[i]) < 1e-5f);
+        assert(std::abs(reverb_ir_stereo[1].buffer[i] + reverb_direct.buffer[i]) < 1e-5f);
+      }
+    }
+    
+    {
+      // Second-order sections vs transfer function polynomials.
+      Waveform wave_f(4000, 0.f);
+      wave_f.sample_rate = 44100;
+      for (int i = 0; i < 4000; ++i)
+        wave_f.buffer[i] = std::sin(0.05f*i) + 0.5f*std::sin(0.9f*i) + (i == 100 ? 1.f : 0.f);
+      for (auto op_type : { FilterOpType::LowPass, FilterOpType::HighPass })
+        for (int order = 1; order <= 3; ++order)
+        {
+          auto tf = WaveformHelper::create_Butterworth_filter(order, op_type, 2000.f, {}, 44100.f);
+          auto sos = WaveformHelper::create_Butterworth_filter_sos(order, op_type, 2000.f, {}, 44100.f);
+          assert(static_cast<int>(sos.sections.size()) == (order + 1)/2);
+          auto y_tf = WaveformHelper::filter(wave_f.buffer, tf);
+          auto y_sos = WaveformHelper::filter(wave_f.buffer, sos);
+          for (int i = 0; i < 4000; ++i)
+            assert(std::abs(y_tf[i] - y_sos[i]) < 1e-4f);
+        }
+      
+      // High order band-pass stays bounded.
+      auto bp_sos = WaveformHelper::create_Butterworth_filter_sos(8, FilterOpType::BandPass, 2000.f, 800.f, 44100.f);
+      assert(bp_sos.sections.size() == 8);
+      auto y_bp = WaveformHelper::filter(wave_f, bp_sos);
+      for (auto y : y_bp.buffer)
+        assert(std::isfinite(y) && std::abs(y) < 2.f);
+      
+      // Filter design cache.
+      FilterDesignCache::clear();
+      auto y_c0 = WaveformHelper::filter(wave_f, FilterType::ChebyshevTypeI, FilterOpType::LowPass, 3, 2000.f, std::nullopt, 0.5f);
+      auto y_c1 = WaveformHelper::filter(wave_f, FilterType::ChebyshevTypeI, FilterOpType::LowPass, 3, 2000.f, std::nullopt, 0.5f);
+      assert(FilterDesignCache::num_misses() == 1);
+      assert(FilterDesignCache::num_hits() == 1);
+      assert(y_c0.buffer == y_c1.buffer);
+      FilterDesignCache::set_capacity(2);
+      for (int i = 0; i < 4; ++i)
+        WaveformHelper::design_filter_sos(FilterType::Butterworth, FilterOpType::HighPass, 2, 100.f*(i + 1), std::nullopt, 0.f, 44100);
+      assert(FilterDesignCache::size() == 2);
+      assert(FilterDesignCache::num_misses() == 5);
+      FilterDesignCache::set_capacity(256);
+      FilterDesignCache::clear();
+      
+      // Streaming in uneven blocks gives the same output as filtering the whole buffer.
+      auto cheby_tf = WaveformHelper::create_ChebyshevI_filter(3, FilterOpType::HighPass, 1500.f, {}, 0.5f, 44100);
+      FilterProcessor proc_tf(cheby_tf);
+      FilterProcessor proc_sos(bp_sos);
+      std::vector<float> y_stream_tf(4000, 0.f);
+      std::vector<float> y_stream_sos = wave_f.buffer;
+      for (int start = 0, len = 1; start < 4000; start += len, len = len*3 % 97 + 1)
+      {
+        len = std::min(len, 4000 - start);
+        proc_tf.process(std::span<const float>(wave_f.buffer).subspan(start, len),
+                        std::span<float>(y_stream_tf).subspan(start, len));
+        auto blk = std::span<float>(y_stream_sos).subspan(start, len);
+        proc_sos.process(blk, blk);
+      }
+      assert(y_stream_tf == WaveformHelper::filter(wave_f.buffer, cheby_tf));
+      assert(y_stream_sos == y_bp.buffer);
+      
+      // Multi-lane filtering of waveforms of different lengths and frequencies, with different filter orders.
+      std::vector<Waveform> waves_ml;
+      std::vector<FilterArgs> args_ml;
+      for (int i = 0; i < 11; ++i)
+      {
+        Waveform w = wave_f;
+        w.buffer.resize(4000 - 300*i);
+        w.frequency = 200.f + 50.f*i;
+        waves_ml.emplace_back(w);
+        FilterArgs fa;
+        fa.filter_type = i % 2 == 0 ? FilterType::Butterworth : FilterType::ChebyshevTypeI;
+        fa.filter_op_type = i % 3 == 0 ? FilterOpType::HighPass : FilterOpType::LowPass;
+        fa.filter_order = 1 + i % 5;
+        args_ml.emplace_back(fa);
+      }
+      std::vector<std::pair<Waveform*, const FilterArgs*>> jobs_ml;
+      auto waves_ml_filtered = waves_ml;
+      for (int i = 0; i < 11; ++i)
+        jobs_ml.emplace_back(&waves_ml_filtered[i], &args_ml[i]);
+      WaveformHelper::filter_multi_lane(jobs_ml);
+      for (int i = 0; i < 11; ++i)
+      {
+        auto w_ref = WaveformHelper::filter(waves_ml[i], args_ml[i]);
+        assert(waves_ml_filtered[i].buffer.size() == w_ref.buffer.size());
+        for (size_t j = 0; j < w_ref.buffer.size(); ++j)
+          assert(std::abs(waves_ml_filtered[i].buffer[j] - w_ref.buffer[j]) < 1e-5f);
+      }
+      
+      // Interleaved stereo, one lane per channel.
+      auto sos_l = WaveformHelper::create_Butterworth_filter_sos(4, FilterOpType::LowPass, 1000.f, {}, 44100);
+      auto sos_r = WaveformHelper::create_ChebyshevII_filter_sos(3, FilterOpType::HighPass, 3000.f, {}, 20.f, 44100);
+      MultiLaneFilterProcessor proc_lr({ sos_l, sos_r });
+      std::vector<float> lr(8000, 0.f);
+      for (int i = 0; i < 4000; ++i)
+      {
+        lr[2*i] = wave_f.buffer[i];
+        lr[2*i + 1] = -wave_f.buffer[i];
+      }
+      proc_lr.process_interleaved(lr, lr);
+      auto y_l = WaveformHelper::filter(wave_f.buffer, sos_l);
+      auto y_r = WaveformHelper::filter(wave_f.buffer, sos_r);
+      for (int i = 0; i < 4000; ++i)
+      {
+        assert(std::abs(lr[2*i] - y_l[i]) < 1e-5f);
+        assert(std::abs(lr[2*i + 1] + y_r[i]) < 1e-5f);
+      }
+    }
+    
+    {
+      // Segment based ADSR envelope vs the analytic curves.
+      ADSR adsr { { ADSRMode::EXP, 100 }, { ADSRMode::LOG, 100 }, { 0.5f }, { ADSRMode::EXP, 200 } };
+      Waveform wave_e(44100, 2.f);
+      wave_e.duration = 1.f;
+      auto env = WaveformHelper::envelope_adsr(wave_e, adsr);
+      auto f_env = [](float t)
+      {
+        if (t <= 0.1f)
+          return std::exp2(t/0.1f) - 1.f;
+        if (t <= 0.2f)
+          return 1.f + 0.5f*std::log(1.f - (t - 0.1f)/0.1f*(1.f - 1.f/math::c_e));
+        if (t <= 0.8f)
+          return 0.5f;
+        return 0.5f - 0.5f*(2.f - 2.f*std::exp2(-(t - 0.8f)/0.2f));
+      };
+      for (int i = 0; i < 44100; i += 7)
+        assert(std::abs(env.buffer[i] - 2.f*f_env(i/44100.f)) < 1e-4f);
+      
+      // In-place, and a zero attack time starts on the decay curve.
+      ADSR adsr_0 { { ADSRMode::LIN, 0 }, { ADSRMode::LIN, 100 }, { 0.5f }, { ADSRMode::LIN, 100 } };
+      WaveformHelper::apply_envelope_adsr(wave_e, adsr_0);
+      assert(wave_e.buffer[0] == 2.f);
+      assert(std::abs(wave_e.buffer[2205] - 1.5f) < 1e-4f);
+      assert(wave_e.buffer[44099] < 1e-3f);
+    }
+    
+    {
+      // In-place and output argument variants give the same result as the copying ones.
+      Waveform wave_a(3000, 0.f);
+      Waveform wave_b(2500, 0.f);
+      for (int i = 0; i < 3000; ++i)
+        wave_a.buffer[i] = std::sin(0.03f*i);
+      for (int i = 0; i < 2500; ++i)
+        wave_b.buffer[i] = std::cos(0.07f*i);
+      wave_a.update_duration();
+      wave_b.update_duration();
+      
+      FilterArgs fa { FilterType::ChebyshevTypeI, FilterOpType::LowPass, 3, 4.f };
+      auto w_filt = WaveformHelper::filter(wave_a, fa);
+      auto w_inpl = wave_a;
+      WaveformHelper::apply_filter(w_inpl, fa);
+      assert(w_inpl.buffer == w_filt.buffer);
+      
+      auto w_flanger = WaveformHelper::flanger(wave_a, 3e-3f, 0.9f, 0.5f);
+      w_inpl = wave_a;
+      WaveformHelper::apply_flanger(w_inpl, 3e-3f, 0.9f, 0.5f);
+      assert(w_inpl.buffer == w_flanger.buffer);
+      
+      auto w_ring = WaveformHelper::ring_modulation(wave_a, wave_b);
+      w_inpl = wave_a;
+      WaveformHelper::apply_ring_modulation(w_inpl, wave_b);
+      assert(w_inpl.buffer == w_ring.buffer);
+      assert(w_inpl.buffer.size() == 2500);
+      
+      Waveform w_res;
+      WaveformHelper::resample(wave_a, w_res, 22050);
+      assert(w_res.buffer == WaveformHelper::resample(wave_a, 22050).buffer);
+      assert(w_res.sample_rate == 22050);
+      
+      auto w_sub = WaveformHelper::subset(wave_a, 100, 500);
+      w_inpl = wave_a;
+      WaveformHelper::subset(w_inpl, w_inpl, 100, 500);
+      assert(w_inpl.buffer == w_sub.buffer);
+      assert(w_inpl.buffer.size() == 500 && w_inpl.buffer[0] == wave_a.buffer[100]);
+    }
+    
+    {
+      // Polyphase resampling of a 48 kHz sine to 44.1 kHz, offline, in place and streamed in uneven blocks.
+      auto f_sine = [](int sample_rate, int N)
+      {
+        Waveform w(N, 0.f);
+        w.sample_rate = sample_rate;
+        for (int i = 0; i < N; ++i)
+          w.buffer[i] = std::sin(math::c_2pi*1000.f*i/sample_rate);
+        w.update_duration();
+        return w;
+      };
+      auto wave_48k = f_sine(48000, 9600);
+      auto wave_44k = f_sine(44100, 8820);
+      auto w_res = WaveformHelper::resample(wave_48k, 44100, ResamplerQuality::MEDIUM);
+      assert(w_res.sample_rate == 44100 && w_res.buffer.size() == 8820);
+      for (size_t i = 100; i < 8720; ++i)
+        assert(std::abs(w_res.buffer[i] - wave_44k.buffer[i]) < 1e-3f);
+      
+      auto w_inpl = wave_48k;
+      WaveformHelper::resample(w_inpl, w_inpl, 44100, ResamplerQuality::MEDIUM);
+      assert(w_inpl.buffer == w_res.buffer);
+      
+      Resampler resampler(48000, 44100, ResamplerQuality::MEDIUM);
+      std::vector<float> y_stream;
+      for (size_t start = 0, len = 1; start < 9600; start += len, len = len*7 % 301 + 1)
+      {
+        len = std::min<size_t>(len, 9600 - start);
+        resampler.process(std::span<const float>(wave_48k.buffer).subspan(start, len), y_stream);
+      }
+      resampler.flush(y_stream);
+      assert(y_stream == w_res.buffer);
+    }
+    
+    {
+      // Mixing bus with offsets, padded to the longest input, vs summing sample by sample.
+      std::vector<float> in_a(3000), in_b(1500), in_c(2000);
+      for (int i = 0; i < 3000; ++i)
+        in_a[i] = std::sin(0.01f*i);
+      for (int i = 0; i < 1500; ++i)
+        in_b[i] = std::cos(0.02f*i);
+      for (int i = 0; i < 2000; ++i)
+        in_c[i] = 0.5f - (i % 100)*0.01f;
+      MixBus bus;
+      bus.add_input(in_a, 0.5f).add_input(in_b, 0.3f, 2200).add_input(in_c, 0.2f, 100);
+      assert(bus.length() == 2100);
+      assert(bus.length(true) == 3700);
+      std::vector<float> y(3700);
+      bus.mix(std::span<float>(y).first(1234));
+      bus.mix(std::span<float>(y).subspan(1234), 1234);
+      for (size_t i = 0; i < y.size(); ++i)
+      {
+        float ref = 0.f;
+        if (i < 3000)
+          ref += 0.5f*in_a[i];
+        if (i >= 2200)
+          ref += 0.3f*in_b[i - 2200];
+        if (i >= 100 && i < 2100)
+          ref += 0.2f*in_c[i - 100];
+        assert(std::abs(y[i] - ref) < 1e-6f);
+      }
+      
+      Waveform wave_a(3000, 0.f);
+      Waveform wave_b(1500, 0.f);
+      wave_a.buffer = in_a;
+      wave_b.buffer = in_b;
+      auto w_mix = WaveformHelper::mix({ { 0.5f, wave_a }, { 0.3f, wave_b } });
+      auto w_mix_ptr = WaveformHelper::mix({ { 0.5f, &wave_a }, { 0.3f, &wave_b } }, true);
+      assert(w_mix.buffer.size() == 1500 && w_mix_ptr.buffer.size() == 3000);
+      assert(std::equal(w_mix.buffer.begin(), w_mix.buffer.end(), w_mix_ptr.buffer.begin()));
+      assert(w_mix_ptr.buffer[2000] == 0.5f*in_a[2000]/0.8f);
+    }
   }
-
+  
 }
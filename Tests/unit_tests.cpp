@@ -6,6 +6,7 @@
 //
 
 #include "WaveformHelper_tests.h"
+#include "WaveformGeneration_tests.h"
 #include "ChipTuneEngine_tests.h"
 #include <filesystem>
 #include <iostream>
@@ -15,6 +16,9 @@ int main(int argc, char** argv)
 {
   std::cout << "### WaveformHelper Tests ###" << std::endl;
   beat::unit_tests();
+  
+  std::cout << "### WaveformGeneration Tests ###" << std::endl;
+  beat::waveform_generation_unit_tests();
 
   std::cout << "### ChipTuneEngine Tests ###" << std::endl;
   beat::chiptune_engine_unit_tests(
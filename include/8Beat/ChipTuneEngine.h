@@ -9,6 +9,7 @@
 #include "ChipTuneEngine_Internals/ChipTuneEngineParser.h"
 #include "ChipTuneEngineListener.h"
 #include "AudioSourceHandler.h"
+#include "Convolver.h"
 #include "Waveform.h"
 #include "WaveformGeneration.h"
 
@@ -20,6 +21,8 @@
 #include <chrono>
 #include <thread>
 #include <atomic>
+#include <memory>
+#include <mutex>
 
 
 namespace beat
@@ -245,7 +248,12 @@ namespace beat
             {
               if (interrupt_unfinished_note)
                 voice.src->stop();
-              if (m_ir_sound != nullptr)
+              if (auto ir = get_reverb_ir(); ir != nullptr)
+              {
+                auto wd_rev = WaveformHelper::reverb(note->wave, *ir);
+                voice.src->update_buffer(wd_rev);
+              }
+              else if (m_ir_sound != nullptr)
               {
                 auto wd_rev = WaveformHelper::reverb_fast(note->wave, *m_ir_sound);
                 voice.src->update_buffer(wd_rev);
@@ -377,18 +385,37 @@ namespace beat
       m_ext_gain_vol = gain;
     }
     
-    // #WARNING: Super-slow!!!
+    // #WARNING: Super-slow!!! The IR is transformed for every note.
+    //   Prefer the ImpulseResponse overload.
     void set_reverb_ir(const Waveform* ir)
     {
+      set_reverb_ir(std::shared_ptr<const ImpulseResponse> {});
       m_ir_sound = ir;
     }
     
+    // The IR spectra are computed once when the ImpulseResponse is created.
+    // Only the first channel is used. Shared with the playback thread, which keeps it alive
+    //   for the note being processed even if it is replaced or reset meanwhile.
+    void set_reverb_ir(std::shared_ptr<const ImpulseResponse> ir)
+    {
+      m_ir_sound = nullptr;
+      std::scoped_lock lock(m_ir_mutex);
+      m_ir = std::move(ir);
+    }
+    
     void reset_reverb()
     {
       m_ir_sound = nullptr;
+      set_reverb_ir(std::shared_ptr<const ImpulseResponse> {});
     }
     
   private:
+    std::shared_ptr<const ImpulseResponse> get_reverb_ir()
+    {
+      std::scoped_lock lock(m_ir_mutex);
+      return m_ir;
+    }
+    
     std::thread m_audio_thread;
     std::atomic<bool> m_stop_audio_thread = false;
     std::atomic<bool> m_restart_audio_thread = false;
@@ -399,6 +426,8 @@ namespace beat
     std::atomic<float> m_ext_gain = 1.f;
     std::atomic<float> m_ext_gain_vol = 1.f;
     std::atomic<Waveform const *> m_ir_sound = nullptr;
+    std::shared_ptr<const ImpulseResponse> m_ir;
+    std::mutex m_ir_mutex;
     std::atomic<bool> m_use_reverb = false;
   };
 
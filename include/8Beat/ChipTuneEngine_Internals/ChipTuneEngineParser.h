@@ -8,6 +8,7 @@
 #pragma once
 
 #include "../Synthesizer.h"
+#include "../EffectChain.h"
 #include "../AudioSourceHandler.h"
 #include <Core/Utils.h>
 #include <Core/StringHelper.h>
@@ -240,7 +241,8 @@ namespace beat
     std::vector<InstrumentLib> m_instruments_lib;
     std::vector<ADSR> m_envelopes;
     std::vector<FilterArgs> m_filter_args;
-    std::vector<WaveformGenerationParams> m_waveform_params;
+    // Compiled once at load and reused for every note.
+    std::vector<CompiledWaveformGenerationParams> m_waveform_params;
     
     std::map<int, float> m_time_step_ms;
     float m_curr_time_step_ms = 100;
@@ -926,7 +928,7 @@ namespace beat
       
       iss >> params_nr;
       if (static_cast<int>(m_waveform_params.size()) < params_nr + 1)
-        m_waveform_params.resize(params_nr + 1);
+        m_waveform_params.resize(params_nr + 1, CompiledWaveformGenerationParams(WaveformGenerationParams {}));
       
       std::string modifier, modifier_name, modifier_val;
       WaveformGenerationParams params;
@@ -986,6 +988,18 @@ namespace beat
           else if (f_parse_val("noise_flt_order", params.noise_filter_order)) {}
           else if (f_parse_val("noise_flt_rel_bw", params.noise_filter_rel_bw)) {}
           else if (f_parse_val("noise_flt_slot_dur_s", params.noise_filter_slot_dur_s)) {}
+          else if (f_parse_val("control_rate", params.control_rate)) {}
+          else if (f_parse_val("band_limited", params.band_limited)) {}
+          else if (bool fast_math = false; f_parse_val("fast_math", fast_math))
+            params.math_policy = fast_math ? MathPolicy::FAST : MathPolicy::PRECISE;
+          else if (modifier_name == "seed")
+          {
+            uint64_t seed = 0;
+            if (!(std::istringstream(modifier_val) >> seed))
+              std::cerr << "Error parsing seed in params line: \"" << line << "\"." << std::endl;
+            else
+              params.seed = seed;
+          }
           else if (modifier_name == "arpeggio")
           {
             const std::string op = "arpeggio:";
@@ -1036,7 +1050,7 @@ namespace beat
         }
       }
       
-      m_waveform_params[params_nr] = params;
+      m_waveform_params[params_nr] = CompiledWaveformGenerationParams(params);
     }
     
     void parse_tab(const std::string& line, std::istringstream& iss)
@@ -1207,22 +1221,72 @@ namespace beat
     Waveform create_instrument_basic(Note* note, const InstrumentBasic& ib)
     {
       Waveform wave;
-      WaveformGenerationParams params;
       if (ib.params_idx >= 0)
-        params = m_waveform_params[ib.params_idx];
-      wave = m_waveform_gen.generate_waveform(ib.waveform, note->duration_ms*1e-3f, note->frequency, params, 44100, false, ib.freq_effect, ib.ampl_effect, ib.phase_effect);
+        wave = m_waveform_gen.generate_waveform(ib.waveform, note->duration_ms*1e-3f, note->frequency, m_waveform_params[ib.params_idx], 44100, false, ib.freq_effect, ib.ampl_effect, ib.phase_effect);
+      else
+        wave = m_waveform_gen.generate_waveform(ib.waveform, note->duration_ms*1e-3f, note->frequency, WaveformGenerationParams {}, 44100, false, ib.freq_effect, ib.ampl_effect, ib.phase_effect);
       
       return wave;
     }
     
-    Waveform create_instrument_ring_mod(Note* note, const InstrumentRingMod& irm)
+    // Renders a basic instrument note with the instrument and note effects in one EffectChain pass.
+    // Returns false if a filter normalizes, since that needs the whole filtered wave.
+    bool create_instrument_basic_fused(Note* note, const InstrumentBasic& ib)
     {
-      Waveform wave;
+      auto f_normalizes = [this](int flt_idx)
+      {
+        return flt_idx >= 0
+          && m_filter_args[flt_idx].filter_type != FilterType::NONE
+          && m_filter_args[flt_idx].normalize_filtered_wave;
+      };
+      if (f_normalizes(ib.flt_idx) || f_normalizes(note->flt_idx))
+        return false;
+      
+      auto& wave = note->wave;
+      EffectChain chain;
+      if (ib.waveform == WaveformType::NOISE)
+        wave = create_instrument_basic(note, ib); // Normalized over the whole note.
+      else
+      {
+        const float duration_s = note->duration_ms*1e-3f;
+        const int sample_rate = 44100;
+        wave.frequency = note->frequency;
+        wave.sample_rate = sample_rate;
+        wave.duration = duration_s;
+        wave.buffer.resize(static_cast<int>(duration_s * sample_rate));
+        if (ib.params_idx >= 0)
+          chain.add_generator(Oscillator(ib.waveform, duration_s, note->frequency, m_waveform_params[ib.params_idx], sample_rate, ib.freq_effect, ib.ampl_effect, ib.phase_effect));
+        else
+          chain.add_generator(Oscillator(ib.waveform, duration_s, note->frequency, WaveformGenerationParams {}, sample_rate, ib.freq_effect, ib.ampl_effect, ib.phase_effect));
+      }
+      
+      // Same stages as apply_filter() and apply_envelope_adsr(), instrument effects first.
+      auto f_add_post_effects = [&](int flt_idx, int adsr_idx)
+      {
+        if (flt_idx >= 0 && m_filter_args[flt_idx].filter_type != FilterType::NONE)
+        {
+          chain.add_filter(WaveformHelper::design_filter_sos(m_filter_args[flt_idx], wave.frequency, wave.sample_rate));
+          chain.add_clamp();
+        }
+        if (adsr_idx >= 0)
+        {
+          chain.add_envelope(EnvelopeGenerator(m_envelopes[adsr_idx], wave.duration, wave.sample_rate, wave.buffer.size()));
+          wave.update_duration();
+        }
+      };
+      f_add_post_effects(ib.flt_idx, ib.adsr_idx);
+      f_add_post_effects(note->flt_idx, note->adsr_idx);
       
-      Waveform wave_A = create_waveform(note, irm.ring_mod_instr_name_A);
+      chain.process(wave.buffer);
+      return true;
+    }
+    
+    Waveform create_instrument_ring_mod(Note* note, const InstrumentRingMod& irm)
+    {
+      Waveform wave = create_waveform(note, irm.ring_mod_instr_name_A);
       Waveform wave_B = create_waveform(note, irm.ring_mod_instr_name_B);
       
-      wave = WaveformHelper::ring_modulation(wave_A, wave_B);
+      WaveformHelper::apply_ring_modulation(wave, wave_B);
       
       return wave;
     }
@@ -1245,10 +1309,7 @@ namespace beat
       
       std::vector<std::pair<float, Waveform>> weighted_waves;
       for (const auto& iwp : iwa.instrument_names)
-      {
-        auto ww = create_waveform(note, iwp.second);
-        weighted_waves.emplace_back(iwp.first, ww);
-      }
+        weighted_waves.emplace_back(iwp.first, create_waveform(note, iwp.second));
       
       wave = WaveformHelper::mix(weighted_waves);
       
@@ -1286,22 +1347,36 @@ namespace beat
       return wave;
     }
     
-    void apply_post_effects(Waveform& wave, int flt_idx, int adsr_idx)
+    struct PostEffects
     {
-      if (flt_idx >= 0)
-      {
-        const auto& fa = m_filter_args[flt_idx];
-        wave = WaveformHelper::filter(wave, fa);
-      }
-      if (adsr_idx >= 0)
+      Waveform* wave = nullptr;
+      int flt_idx = -1;
+      int adsr_idx = -1;
+    };
+    
+    // The filters of all the notes run together, several notes at a time in SIMD lanes.
+    void apply_post_effects(const std::vector<PostEffects>& post_effects)
+    {
+      std::vector<std::pair<Waveform*, const FilterArgs*>> filter_jobs;
+      for (const auto& pe : post_effects)
+        if (pe.flt_idx >= 0)
+          filter_jobs.emplace_back(pe.wave, &m_filter_args[pe.flt_idx]);
+      WaveformHelper::filter_multi_lane(filter_jobs);
+      
+      for (const auto& pe : post_effects)
       {
-        const auto& adsr = m_envelopes[adsr_idx];
-        wave = WaveformHelper::envelope_adsr(wave, adsr);
+        if (pe.adsr_idx >= 0)
+        {
+          const auto& adsr = m_envelopes[pe.adsr_idx];
+          WaveformHelper::apply_envelope_adsr(*pe.wave, adsr);
+        }
       }
     }
     
     void create_instruments()
     {
+      std::vector<PostEffects> instr_post_effects;
+      std::vector<PostEffects> note_post_effects;
       for (auto& voice : m_voices)
       {
         for (auto& note : voice.notes)
@@ -1311,43 +1386,49 @@ namespace beat
             if (note->instrument_basic_idx >= 0)
             {
               const auto& ib = m_instruments_basic[note->instrument_basic_idx];
-              note->wave = create_instrument_basic(note.get(), ib);
               note->gain *= ib.gain;
-              apply_post_effects(note->wave, ib.flt_idx, ib.adsr_idx);
+              if (create_instrument_basic_fused(note.get(), ib))
+                continue; // Note effects included.
+              note->wave = create_instrument_basic(note.get(), ib);
+              instr_post_effects.push_back({ &note->wave, ib.flt_idx, ib.adsr_idx });
             }
             else if (note->instrument_ring_mod_idx >= 0)
             {
               const auto& irm = m_instruments_ring_mod[note->instrument_ring_mod_idx];
               note->wave = create_instrument_ring_mod(note.get(), irm);
               note->gain *= irm.gain;
-              apply_post_effects(note->wave, irm.flt_idx, irm.adsr_idx);
+              instr_post_effects.push_back({ &note->wave, irm.flt_idx, irm.adsr_idx });
             }
             else if (note->instrument_conv_idx >= 0)
             {
               const auto& ic = m_instruments_conv[note->instrument_conv_idx];
               note->wave = create_instrument_conv(note.get(), ic);
               note->gain *= ic.gain;
-              apply_post_effects(note->wave, ic.flt_idx, ic.adsr_idx);
+              instr_post_effects.push_back({ &note->wave, ic.flt_idx, ic.adsr_idx });
             }
             else if (note->instrument_weight_avg_idx >= 0)
             {
               const auto& iwa = m_instruments_weight_avg[note->instrument_weight_avg_idx];
               note->wave = create_instrument_weight_avg(note.get(), iwa);
               note->gain *= iwa.gain;
-              apply_post_effects(note->wave, iwa.flt_idx, iwa.adsr_idx);
+              instr_post_effects.push_back({ &note->wave, iwa.flt_idx, iwa.adsr_idx });
             }
             else if (note->instrument_lib_idx >= 0)
             {
               const auto& it = m_instruments_lib[note->instrument_lib_idx];
               note->wave = create_instrument_lib(note.get(), it);
               note->gain *= it.gain;
-              apply_post_effects(note->wave, it.flt_idx, it.adsr_idx);
+              instr_post_effects.push_back({ &note->wave, it.flt_idx, it.adsr_idx });
             }
             
-            apply_post_effects(note->wave, note->flt_idx, note->adsr_idx);
+            note_post_effects.push_back({ &note->wave, note->flt_idx, note->adsr_idx });
           }
         }
       }
+      
+      // Instrument effects first, then the note effects on top.
+      apply_post_effects(instr_post_effects);
+      apply_post_effects(note_post_effects);
     }
     
     void init_voice_sources()
@@ -0,0 +1,418 @@
+//
+//  Convolver.h
+//  8Beat
+//
+//  Created by Rasmus Anthin on 2026-10-17.
+//
+
+#pragma once
+
+#include "FFT.h"
+#include "FastMath.h"
+#include "Waveform.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <vector>
+
+
+namespace beat
+{
+
+  // Impulse response split into partitions of block_size samples whose spectra are
+  // computed once, one set per channel. Can be shared by any number of Convolvers.
+  class ImpulseResponse
+  {
+  public:
+    // kernel: mono impulse response.
+    explicit ImpulseResponse(std::span<const float> kernel, int block_size = 512)
+    {
+      init(block_size, static_cast<int>(kernel.size()));
+      add_channel(kernel);
+    }
+    
+    explicit ImpulseResponse(const Waveform& ir, int block_size = 512)
+      : ImpulseResponse(std::span<const float> { ir.buffer }, block_size)
+    {
+      m_sample_rate = ir.sample_rate;
+      m_frequency = ir.frequency;
+    }
+    
+    // One Waveform per channel, all with the same sample rate.
+    explicit ImpulseResponse(const std::vector<Waveform>& ir_channels, int block_size = 512)
+    {
+      size_t kernel_size = 0;
+      for (const auto& ch : ir_channels)
+        kernel_size = std::max(kernel_size, ch.buffer.size());
+      init(block_size, static_cast<int>(kernel_size));
+      if (!ir_channels.empty())
+      {
+        m_sample_rate = ir_channels[0].sample_rate;
+        m_frequency = ir_channels[0].frequency;
+      }
+      for (const auto& ch : ir_channels)
+      {
+        if (ch.sample_rate != m_sample_rate)
+          std::cerr << "ERROR in ImpulseResponse() : All channels must have the same sample rate!" << std::endl;
+        add_channel(ch.buffer);
+      }
+    }
+    
+    int block_size() const { return m_block_size; }
+    int kernel_size() const { return m_kernel_size; }
+    int num_partitions() const { return m_num_partitions; }
+    int num_channels() const { return static_cast<int>(m_channel_spectra.size()); }
+    int sample_rate() const { return m_sample_rate; }
+    float frequency() const { return m_frequency; }
+    
+    // num_partitions() spectra of block_size() + 1 bins each,
+    // with the 1/(2 block_size()) of the inverse transform folded in.
+    std::span<const std::complex<float>> get_partition_spectra(int channel) const
+    {
+      return m_channel_spectra[channel];
+    }
+    
+    // Prepared real FFT plan of size 2 block_size(), for the Convolvers to copy.
+    const FFTPlan& get_fft_plan() const { return *m_plan; }
+  
+  private:
+    void init(int block_size, int kernel_size)
+    {
+      if (block_size <= 0)
+        std::cerr << "ERROR in ImpulseResponse() : block_size must be positive!" << std::endl;
+      m_block_size = std::max(block_size, 1);
+      m_kernel_size = kernel_size;
+      m_num_partitions = std::max((m_kernel_size + m_block_size - 1) / m_block_size, 1);
+      m_plan = std::make_shared<FFTPlan>(2 * m_block_size);
+      m_plan->prepare_real();
+    }
+    
+    void add_channel(std::span<const float> kernel)
+    {
+      const int B = m_block_size;
+      const int num_bins = B + 1;
+      auto& plan = *m_plan;
+      auto& spectra = m_channel_spectra.emplace_back(m_num_partitions * num_bins);
+      std::vector<float> partition(2 * B);
+      for (int p = 0; p < m_num_partitions; ++p)
+      {
+        std::fill(partition.begin(), partition.end(), 0.f);
+        for (int i = 0; i < B && p * B + i < static_cast<int>(kernel.size()); ++i)
+          partition[i] = kernel[p * B + i] / (2.f * B);
+        plan.forward_real(partition, std::span { &spectra[p * num_bins], static_cast<size_t>(num_bins) });
+      }
+    }
+    
+    int m_block_size = 512;
+    int m_kernel_size = 0;
+    int m_num_partitions = 1;
+    int m_sample_rate = 44100;
+    float m_frequency = 440.f;
+    std::shared_ptr<FFTPlan> m_plan; // Shared by copies, copied by the Convolvers.
+    std::vector<std::vector<std::complex<float>>> m_channel_spectra;
+  };
+  
+  // Uniformly partitioned overlap-save convolution with a fixed latency of one block.
+  // The kernel is split into partitions of block_size samples whose spectra are multiplied with
+  // a frequency-domain delay line of the input block spectra, so the cost per block grows with
+  // the kernel length but not with the length of the signal.
+  // Suitable for long impulse responses on live streams, e.g. called from an AudioStreamListener.
+  class Convolver
+  {
+  public:
+    // kernel: impulse response. block_size: partition size and latency in samples.
+    explicit Convolver(std::span<const float> kernel, int block_size = 512)
+      : m_owned_ir(std::make_unique<ImpulseResponse>(kernel, block_size))
+    {
+      init(*m_owned_ir, 0);
+    }
+    
+    // Convolves with one channel of a precomputed impulse response, which must outlive the convolver.
+    explicit Convolver(const ImpulseResponse& ir, int channel = 0)
+    {
+      init(ir, channel);
+    }
+    
+    int block_size() const { return m_block_size; }
+    int latency() const { return m_block_size; }
+    int kernel_size() const { return m_kernel_size; }
+    
+    // Clears the input history and the pending output.
+    void reset()
+    {
+      std::fill(m_input_spectra.begin(), m_input_spectra.end(), 0.f);
+      std::fill(m_input_window.begin(), m_input_window.end(), 0.f);
+      std::fill(m_output_block.begin(), m_output_block.end(), 0.f);
+      m_fdl_pos = 0;
+      m_pos = 0;
+    }
+    
+    // Output is the convolution delayed by latency() samples.
+    float process_sample(float x)
+    {
+      m_input_window[m_block_size + m_pos] = x;
+      float y = m_output_block[m_pos];
+      if (++m_pos == m_block_size)
+      {
+        process_block();
+        m_pos = 0;
+      }
+      return y;
+    }
+    
+    // Any number of samples. out may be the same buffer as in.
+    void process(std::span<const float> in, std::span<float> out)
+    {
+      const size_t N = std::min(in.size(), out.size());
+      size_t i = 0;
+      while (i < N)
+      {
+        const size_t n = std::min(N - i, static_cast<size_t>(m_block_size - m_pos));
+        std::copy_n(in.begin() + i, n, m_input_window.begin() + m_block_size + m_pos);
+        std::copy_n(m_output_block.begin() + m_pos, n, out.begin() + i);
+        m_pos += static_cast<int>(n);
+        i += n;
+        if (m_pos == m_block_size)
+        {
+          process_block();
+          m_pos = 0;
+        }
+      }
+    }
+    
+    // Full linear convolution of the signal with the kernel, signal.size() + kernel_size() - 1 samples.
+    // The latency is compensated for. Resets the convolver.
+    std::vector<float> convolve(std::span<const float> signal)
+    {
+      reset();
+      if (signal.empty() || m_kernel_size == 0)
+        return {};
+      const size_t conv_size = signal.size() + m_kernel_size - 1;
+      std::vector<float> out(conv_size + m_block_size, 0.f);
+      std::copy(signal.begin(), signal.end(), out.begin());
+      process(out, out);
+      out.erase(out.begin(), out.begin() + m_block_size);
+      reset();
+      return out;
+    }
+    
+    // Direct correlation y[i] = sum_k x[i + k] * kernel[k] for i in [0, y.size()).
+    // x.size() must be >= y.size() + kernel.size() - 1.
+    // Register-blocked over the outputs and cache-blocked over the kernel, using AVX2 or SSE2 when available.
+    static void correlate(std::span<const float> x, std::span<const float> kernel, std::span<float> y)
+    {
+      const size_t No = y.size();
+      const size_t Nk = kernel.size();
+      std::fill(y.begin(), y.end(), 0.f);
+      for (size_t k0 = 0; k0 < Nk; k0 += c_kernel_tile)
+      {
+        const size_t nk = std::min(c_kernel_tile, Nk - k0);
+        const float* xk = x.data() + k0;
+        const float* kk = kernel.data() + k0;
+        size_t i = 0;
+#ifdef BEAT_FASTMATH_AVX2
+        if (FastMath::has_avx2())
+          i = correlate_avx2(xk, kk, nk, y.data(), No);
+#endif
+#ifdef BEAT_FASTMATH_SSE2
+        i += correlate_sse2(xk + i, kk, nk, y.data() + i, No - i);
+#endif
+        for (; i < No; ++i)
+        {
+          float acc = 0.f;
+          for (size_t k = 0; k < nk; ++k)
+            acc += xk[i + k] * kk[k];
+          y[i] += acc;
+        }
+      }
+    }
+    
+    // Full linear convolution by direct summation, signal.size() + kernel.size() - 1 samples.
+    static std::vector<float> convolve_direct(std::span<const float> signal, std::span<const float> kernel)
+    {
+      if (signal.empty() || kernel.empty())
+        return {};
+      const size_t Nk = kernel.size();
+      std::vector<float> padded(signal.size() + 2*(Nk - 1), 0.f);
+      std::copy(signal.begin(), signal.end(), padded.begin() + (Nk - 1));
+      std::vector<float> reversed(kernel.rbegin(), kernel.rend());
+      std::vector<float> out(signal.size() + Nk - 1);
+      correlate(padded, reversed, out);
+      return out;
+    }
+    
+    // True if direct convolution is estimated to be faster than FFT convolution.
+    // Compares the multiply-adds per output sample of direct convolution with
+    // the log2 cost per sample of the FFTs. The factors are calibrated by benchmarks:
+    // with AVX2 direct convolution wins up to kernels of about 64 log2(N) samples.
+    static bool prefer_direct(size_t signal_size, size_t kernel_size)
+    {
+      const size_t Nmin = std::min(signal_size, kernel_size);
+      const auto N = static_cast<float>(signal_size + kernel_size);
+      float cost_ratio = c_direct_vs_fft_cost;
+#ifdef BEAT_FASTMATH_AVX2
+      if (FastMath::has_avx2())
+        cost_ratio = c_direct_vs_fft_cost_avx2;
+#endif
+      return static_cast<float>(Nmin) <= cost_ratio * std::log2(std::max(N, 2.f));
+    }
+  
+  private:
+    static constexpr size_t c_kernel_tile = 1024;
+    static constexpr float c_direct_vs_fft_cost = 24.f;
+    static constexpr float c_direct_vs_fft_cost_avx2 = 64.f;
+
+#ifdef BEAT_FASTMATH_SSE2
+    // Four accumulators of four outputs each.
+    static size_t correlate_sse2(const float* x, const float* kernel, size_t Nk, float* y, size_t No)
+    {
+      size_t i = 0;
+      for (; i + 16 <= No; i += 16)
+      {
+        __m128 a0 = _mm_loadu_ps(y + i);
+        __m128 a1 = _mm_loadu_ps(y + i + 4);
+        __m128 a2 = _mm_loadu_ps(y + i + 8);
+        __m128 a3 = _mm_loadu_ps(y + i + 12);
+        const float* xi = x + i;
+        for (size_t k = 0; k < Nk; ++k)
+        {
+          __m128 w = _mm_set1_ps(kernel[k]);
+          a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(xi + k), w));
+          a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(xi + k + 4), w));
+          a2 = _mm_add_ps(a2, _mm_mul_ps(_mm_loadu_ps(xi + k + 8), w));
+          a3 = _mm_add_ps(a3, _mm_mul_ps(_mm_loadu_ps(xi + k + 12), w));
+        }
+        _mm_storeu_ps(y + i, a0);
+        _mm_storeu_ps(y + i + 4, a1);
+        _mm_storeu_ps(y + i + 8, a2);
+        _mm_storeu_ps(y + i + 12, a3);
+      }
+      for (; i + 4 <= No; i += 4)
+      {
+        __m128 a = _mm_loadu_ps(y + i);
+        for (size_t k = 0; k < Nk; ++k)
+          a = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(x + i + k), _mm_set1_ps(kernel[k])));
+        _mm_storeu_ps(y + i, a);
+      }
+      return i;
+    }
+#endif
+
+#ifdef BEAT_FASTMATH_AVX2
+    // Four accumulators of eight outputs each.
+    BEAT_FASTMATH_TARGET_AVX2
+    static size_t correlate_avx2(const float* x, const float* kernel, size_t Nk, float* y, size_t No)
+    {
+      size_t i = 0;
+      for (; i + 32 <= No; i += 32)
+      {
+        __m256 a0 = _mm256_loadu_ps(y + i);
+        __m256 a1 = _mm256_loadu_ps(y + i + 8);
+        __m256 a2 = _mm256_loadu_ps(y + i + 16);
+        __m256 a3 = _mm256_loadu_ps(y + i + 24);
+        const float* xi = x + i;
+        for (size_t k = 0; k < Nk; ++k)
+        {
+          __m256 w = _mm256_set1_ps(kernel[k]);
+          a0 = _mm256_fmadd_ps(_mm256_loadu_ps(xi + k), w, a0);
+          a1 = _mm256_fmadd_ps(_mm256_loadu_ps(xi + k + 8), w, a1);
+          a2 = _mm256_fmadd_ps(_mm256_loadu_ps(xi + k + 16), w, a2);
+          a3 = _mm256_fmadd_ps(_mm256_loadu_ps(xi + k + 24), w, a3);
+        }
+        _mm256_storeu_ps(y + i, a0);
+        _mm256_storeu_ps(y + i + 8, a1);
+        _mm256_storeu_ps(y + i + 16, a2);
+        _mm256_storeu_ps(y + i + 24, a3);
+      }
+      for (; i + 8 <= No; i += 8)
+      {
+        __m256 a = _mm256_loadu_ps(y + i);
+        for (size_t k = 0; k < Nk; ++k)
+          a = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + k), _mm256_set1_ps(kernel[k]), a);
+        _mm256_storeu_ps(y + i, a);
+      }
+      return i;
+    }
+#endif
+    
+    void init(const ImpulseResponse& ir, int channel)
+    {
+      m_ir = &ir;
+      m_block_size = ir.block_size();
+      m_kernel_size = ir.kernel_size();
+      m_num_partitions = ir.num_partitions();
+      if (channel < 0 || channel >= ir.num_channels())
+      {
+        std::cerr << "ERROR in Convolver() : channel " << channel << " out of range!" << std::endl;
+        channel = 0;
+      }
+      m_channel = channel;
+      
+      const int B = m_block_size;
+      // A plan of its own, so that process() neither allocates nor shares scratch buffers between threads.
+      m_plan = std::make_unique<FFTPlan>(ir.get_fft_plan());
+      m_input_spectra.resize(m_num_partitions * (B + 1));
+      m_accum.resize(B + 1);
+      m_input_window.resize(2 * B);
+      m_output_window.resize(2 * B);
+      m_output_block.resize(B);
+      reset();
+    }
+    
+    void process_block()
+    {
+      const int B = m_block_size;
+      const int num_bins = B + 1;
+      const int P = m_num_partitions;
+      
+      // Spectrum of the previous and the current input block into the delay line.
+      std::span<std::complex<float>> X { &m_input_spectra[m_fdl_pos * num_bins], static_cast<size_t>(num_bins) };
+      m_plan->forward_real(m_input_window, X);
+      
+      // Sum of the delayed input spectra times the kernel partition spectra.
+      // An impulse response without channels gives silence.
+      std::span<const std::complex<float>> kernel_spectra;
+      if (m_ir->num_channels() > 0)
+        kernel_spectra = m_ir->get_partition_spectra(m_channel);
+      std::fill(m_accum.begin(), m_accum.end(), 0.f);
+      float* acc = reinterpret_cast<float*>(m_accum.data());
+      for (int p = 0; p < P && !kernel_spectra.empty(); ++p)
+      {
+        const int fdl_idx = (m_fdl_pos - p + P) % P;
+        const float* x = reinterpret_cast<const float*>(&m_input_spectra[fdl_idx * num_bins]);
+        const float* h = reinterpret_cast<const float*>(&kernel_spectra[p * num_bins]);
+        for (int k = 0; k < 2 * num_bins; k += 2)
+        {
+          acc[k] += x[k]*h[k] - x[k + 1]*h[k + 1];
+          acc[k + 1] += x[k]*h[k + 1] + x[k + 1]*h[k];
+        }
+      }
+      
+      // The second half of the circular convolution is the valid linear convolution.
+      m_plan->inverse_real(m_accum, m_output_window);
+      std::copy(m_output_window.begin() + B, m_output_window.end(), m_output_block.begin());
+      
+      std::copy(m_input_window.begin() + B, m_input_window.end(), m_input_window.begin());
+      m_fdl_pos = (m_fdl_pos + 1) % P;
+    }
+    
+    std::unique_ptr<ImpulseResponse> m_owned_ir;
+    const ImpulseResponse* m_ir = nullptr;
+    int m_channel = 0;
+    std::unique_ptr<FFTPlan> m_plan;
+    int m_block_size = 512;
+    int m_kernel_size = 0;
+    int m_num_partitions = 1;
+    std::vector<std::complex<float>> m_input_spectra;
+    std::vector<std::complex<float>> m_accum;
+    std::vector<float> m_input_window;
+    std::vector<float> m_output_window;
+    std::vector<float> m_output_block;
+    int m_fdl_pos = 0;
+    int m_pos = 0;
+  };
+  
+}
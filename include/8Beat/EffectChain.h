@@ -0,0 +1,184 @@
+//
+//  EffectChain.h
+//  8Beat
+//
+//  Created by Rasmus Anthin on 2026-10-17.
+//
+
+#pragma once
+
+#include "EnvelopeGenerator.h"
+#include "FilterProcessor.h"
+#include "MixBus.h"
+#include "WaveformGeneration.h"
+#include <algorithm>
+#include <array>
+#include <span>
+#include <variant>
+#include <vector>
+
+
+namespace beat
+{
+
+  // A sound built from stages, e.g. generator -> filter -> clamp -> envelope -> gain.
+  // process() runs one block of c_block_size samples through all the stages before
+  // moving on to the next block, so the samples stay in the L1 cache instead of
+  // being streamed through memory once per stage.
+  // The stages keep their state between calls, so a buffer can also be processed in parts.
+  class EffectChain
+  {
+  public:
+    static constexpr size_t c_block_size = 256;
+    
+    // Renders the oscillator into the block, replacing the output of the stages before.
+    EffectChain& add_generator(const Oscillator& osc)
+    {
+      m_stages.emplace_back(GeneratorStage { osc });
+      return *this;
+    }
+    
+    // Adds weight * src, e.g. a pre-rendered waveform. Samples past the end of src count as zero.
+    // src must outlive the chain.
+    EffectChain& add_input(std::span<const float> src, float weight = 1.f)
+    {
+      m_stages.emplace_back(InputStage { src, weight });
+      return *this;
+    }
+    
+    // Renders the mix into the block, replacing the output of the stages before.
+    // The inputs of the bus must outlive the chain.
+    EffectChain& add_mix(const MixBus& bus, bool weighted_average = false)
+    {
+      m_stages.emplace_back(MixStage { bus, weighted_average });
+      return *this;
+    }
+    
+    EffectChain& add_filter(const FilterSOS& filter)
+    {
+      m_stages.emplace_back(FilterStage { FilterProcessor(filter) });
+      return *this;
+    }
+    
+    // The envelope is positioned by the sample index from the start of the chain.
+    EffectChain& add_envelope(const EnvelopeGenerator& env)
+    {
+      m_stages.emplace_back(EnvelopeStage { env });
+      return *this;
+    }
+    
+    EffectChain& add_gain(float gain)
+    {
+      m_stages.emplace_back(GainStage { gain });
+      return *this;
+    }
+    
+    EffectChain& add_clamp(float min = -1.f, float max = +1.f)
+    {
+      m_stages.emplace_back(ClampStage { min, max });
+      return *this;
+    }
+    
+    // Multiplies the block by the oscillator.
+    EffectChain& add_ring_mod(const Oscillator& osc)
+    {
+      m_stages.emplace_back(RingModStage { osc });
+      return *this;
+    }
+    
+    size_t num_stages() const { return m_stages.size(); }
+    
+    // Processes the next buffer.size() samples in place.
+    void process(std::span<float> buffer)
+    {
+      for (size_t start = 0; start < buffer.size(); start += c_block_size)
+      {
+        auto block = buffer.subspan(start, std::min(c_block_size, buffer.size() - start));
+        for (auto& stage : m_stages)
+          std::visit([this, block](auto& st) { process_stage(st, block); }, stage);
+        m_pos += block.size();
+      }
+    }
+    
+    // Restarts all the stages from sample 0.
+    void reset()
+    {
+      for (auto& stage : m_stages)
+        std::visit([this](auto& st) { reset_stage(st); }, stage);
+      m_pos = 0;
+    }
+  
+  private:
+    struct GeneratorStage { Oscillator osc; };
+    struct InputStage { std::span<const float> src; float weight = 1.f; };
+    struct MixStage { MixBus bus; bool weighted_average = false; };
+    struct FilterStage { FilterProcessor proc; };
+    struct EnvelopeStage { EnvelopeGenerator env; };
+    struct GainStage { float gain = 1.f; };
+    struct ClampStage { float min = -1.f; float max = +1.f; };
+    struct RingModStage { Oscillator osc; };
+    using Stage = std::variant<GeneratorStage, InputStage, MixStage, FilterStage, EnvelopeStage,
+                               GainStage, ClampStage, RingModStage>;
+    
+    void process_stage(GeneratorStage& st, std::span<float> block)
+    {
+      st.osc.render(block);
+    }
+    
+    void process_stage(InputStage& st, std::span<float> block)
+    {
+      if (m_pos >= st.src.size())
+        return;
+      const size_t N = std::min(block.size(), st.src.size() - m_pos);
+      MixBus::accumulate(block.first(N), st.src.subspan(m_pos), st.weight);
+    }
+    
+    void process_stage(MixStage& st, std::span<float> block)
+    {
+      st.bus.mix(block, m_pos, st.weighted_average);
+    }
+    
+    void process_stage(FilterStage& st, std::span<float> block)
+    {
+      st.proc.process(block, block);
+    }
+    
+    void process_stage(EnvelopeStage& st, std::span<float> block)
+    {
+      st.env.apply(block, m_pos);
+    }
+    
+    void process_stage(GainStage& st, std::span<float> block)
+    {
+      for (auto& s : block)
+        s *= st.gain;
+    }
+    
+    void process_stage(ClampStage& st, std::span<float> block)
+    {
+      for (auto& s : block)
+        if (s > st.max)
+          s = st.max;
+        else if (s < st.min)
+          s = st.min;
+    }
+    
+    void process_stage(RingModStage& st, std::span<float> block)
+    {
+      std::span<float> mod { m_scratch.data(), block.size() };
+      st.osc.render(mod);
+      for (size_t i = 0; i < block.size(); ++i)
+        block[i] *= mod[i];
+    }
+    
+    void reset_stage(GeneratorStage& st) { st.osc.reset(); }
+    void reset_stage(FilterStage& st) { st.proc.reset(); }
+    void reset_stage(RingModStage& st) { st.osc.reset(); }
+    void reset_stage(auto&) {}
+    
+    std::vector<Stage> m_stages;
+    size_t m_pos = 0;
+    std::array<float, c_block_size> m_scratch {};
+  };
+  
+}
@@ -0,0 +1,377 @@
+//
+//  EnvelopeGenerator.h
+//  8Beat
+//
+//  Created by Rasmus Anthin on 2026-10-17.
+//
+
+#pragma once
+
+#include "ADSR.h"
+#include "FastMath.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <span>
+
+
+namespace beat
+{
+
+  // ADSR envelope of a note, split into segments of sample indices once so that each
+  // segment can be evaluated in a tight loop. LIN segments are linear ramps and EXP
+  // segments an exponential recurrence (one multiply per sample), without the per
+  // sample range checks and exp calls. LOG segments still need one log per sample.
+  class EnvelopeGenerator
+  {
+  public:
+    // duration_s: Note duration, in which the ADSR times are fitted as follows:
+    //   If the note is long enough for attack, decay and release, the sustain fills out the rest
+    //   (or lasts at most max_sustain_time_ms), otherwise attack and decay are cut short
+    //   so that the release always ends at the end of the note.
+    EnvelopeGenerator(const ADSR& adsr, float duration_s, int sample_rate, size_t num_samples,
+                      MathPolicy math_policy = MathPolicy::PRECISE)
+      : m_math_policy(math_policy)
+    {
+      // Ex0:
+      // t_a               t_ad               t_ds                   t_sr               t_r
+      // |----- T_a_s ----->|----- T_d_s ----->|----- T_s_max_s ----->|----- T_r_s ----->|
+      // |-------------------------------- T_dur_s ----------------------------------------------------->|
+      //
+      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
+      // t_a = 0, t_ad = .10, t_ds = .20, t_sr = .35, t_r = .45
+      // T_dur_s = .60
+      // t_ad = T_a_s = .10
+      // t_ds = T_a_s + T_d_s = 0.10 + 0.10 = 0.20
+      // t_sr = T_a_s + T_d_s + T_s_max_s = 0.10 + 0.10 + 0.15 = 0.35
+      // t_r = T_a_s + T_d_s + T_s_max_s + T_r_s = .10 + .10 + .15 + .10 = .45
+      
+      // Ex1:
+      // t_a               t_ad               t_ds               t_sr               t_r
+      // |----- T_a_s ----->|----- T_d_s ----->|----- T_s_s ----->|----- T_r_s ----->|
+      // |-------------------------------- T_dur_s --------------------------------->|
+      //
+      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
+      // t_a = 0, t_ad = .10, t_ds = .20, t_sr = .30, t_r = .40
+      // T_dur_s = .40
+      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.40 - .10, 0) = 0.30
+      // t_ad = min(T_ads_s, T_a_s) = min(0.30, 0.10) = 0.10 = T_a_s (original)
+      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0.30, 0.10 + 0.10) = 0.20 = T_a_s + T_d_s (original)
+      // t_sr = max(t_ds, T_ads_s) = max(0.20, 0.30) = 0.30
+      // t_r = T_dur_s = 0.40
+      
+      // Ex2:
+      // |----- T_a_s ----->|----- T_d_s ----->|- T_s_s ->|----- T_r_s ----->|
+      // |---------------------------- T_dur_s ----------------------------->|
+      
+      // Ex3:
+      // |----- T_a_s ----->|----- T_d_s ----->|----- T_r_s ----->|
+      // |------------------------ T_dur_s ---------------------->|
+      //
+      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
+      
+      // Ex4:
+      // t_a              t_ad      t_ds/t_sr            t_r
+      // |----- T_a_s ----->|- T_d_s ->|----- T_r_s ----->|
+      // |-------------------- T_dur_s ------------------>|
+      //
+      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
+      // t_a = 0, t_ad = .10, t_ds = .15, t_sr = .15, t_r = .25
+      // T_dur_s = .25
+      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.25 - .10, 0) = 0.15
+      // t_ad = min(T_ads_s, T_a_s) = min(0.15, 0.10) = 0.10 = T_a_s (original)
+      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0.15, 0.10 + 0.10) = 0.15 < 0.20 = T_a_s + T_d_s
+      // t_sr = max(t_ds, T_ads_s) = max(0.15, 0.15) = 0.15
+      // t_r = T_dur_s = 0.25
+      
+      // Ex5:
+      // t_a          t_ad/t_ds/t_sr          t_r
+      // |----- T_a_s ----->|----- T_r_s ----->|
+      // |-------------- T_dur_s ------------->|
+      //
+      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
+      // t_a = 0, t_ad = .10, t_ds = .10, t_sr = .10, t_r = .20
+      // T_dur_s = .20
+      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.20 - .10, 0) = 0.10
+      // t_ad = min(T_ads_s, T_a_s) = min(0.10, 0.10) = 0.10 = T_a_s (original)
+      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0.10, 0.10 + 0.10) = 0.10 < 0.20 = T_a_s + T_d_s
+      // t_sr = max(t_ds, T_ads_s) = max(0.10, 0.10) = 0.10
+      // t_r = T_dur_s = 0.20
+      
+      // Ex6:
+      // t_a  t_ad/t_ds/t_sr          t_r
+      // |- T_a_s ->|----- T_r_s ----->|
+      // |---------- T_dur_s --------->|
+      //
+      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
+      // t_a = 0, t_ad = .05, t_ds = .05, t_sr = .05, t_r = .15
+      // T_dur_s = .15
+      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.15 - .10, 0) = 0.05
+      // t_ad = min(T_ads_s, T_a_s) = min(0.05, 0.10) = 0.05 < 0.10 = T_a_s
+      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0.05, 0.10 + 0.10) = 0.05 < 0.20 = T_a_s + T_d_s
+      // t_sr = max(t_ds, T_ads_s) = max(0.05, 0.05) = 0.05
+      // t_r = T_dur_s = 0.15
+      
+      // Ex7:
+      // t_a/t_ad/t_ds/t_sr        t_r
+      //         |----- T_r_s ----->|
+      //         |----- T_dur_s --->|
+      //
+      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
+      // t_a = 0, t_ad = 0, t_ds = 0, t_sr = 0, t_r = .10
+      // T_dur_s = .10
+      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.10 - .10, 0) = 0
+      // t_ad = min(T_ads_s, T_a_s) = min(0, 0.10) = 0 < 0.10 = T_a_s
+      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0, 0.10 + 0.10) = 0 < 0.20 = T_a_s + T_d_s
+      // t_sr = max(t_ds, T_ads_s) = max(0, 0) = 0
+      // t_r = T_dur_s = 0.10
+      
+      // Ex8:
+      // t_a/t_ad/t_ds/t_sr           t_r
+      //                |- T_r_s ->|
+      //                |--------->| T_dur_s
+      //
+      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
+      // t_a = 0, t_ad = 0, t_ds = 0, t_sr = 0, t_r = .05
+      // T_dur_s = .05
+      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.05 - .10, 0) = 0
+      // t_ad = min(T_ads_s, T_a_s) = min(0, 0.10) = 0 < 0.10 = T_a_s
+      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0, 0.10 + 0.10) = 0 < 0.20 = T_a_s + T_d_s
+      // t_sr = max(t_ds, T_ads_s) = max(0, 0) = 0
+      // t_r = T_dur_s = 0.05
+      
+      // Ex9:
+      // t_a/t_ad/t_ds/t_sr/t_r
+      //                   |
+      //                   | T_dur_s
+      //
+      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
+      // t_a = 0, t_ad = 0, t_ds = 0, t_sr = 0, t_r = 0
+      // T_dur_s = 0
+      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(0 - .10, 0) = 0
+      // t_ad = min(T_ads_s, T_a_s) = min(0, 0.10) = 0 < 0.10 = T_a_s
+      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0, 0.10 + 0.10) = 0 < 0.20 = T_a_s + T_d_s
+      // t_sr = max(t_ds, T_ads_s) = max(0, 0) = 0
+      // t_r = T_dur_s = 0
+      
+      const float T_dur_s = duration_s;
+      const float T_a_s = adsr.get_time_A_ms() * 1e-3f;
+      const float T_d_s = adsr.get_time_D_ms() * 1e-3f;
+      const auto T_s_max_ms = adsr.get_max_time_S_ms();
+      const float T_r_s = adsr.get_time_R_ms() * 1e-3f;
+      
+      const float t_a = 0.f;
+      const float T_ads_s = std::max(T_dur_s - T_r_s, 0.f);
+      float t_ad = std::min(T_ads_s, T_a_s);
+      float t_ds = std::min(T_ads_s, T_a_s + T_d_s);
+      float t_sr = std::max(t_ds, T_ads_s);
+      float t_r = T_dur_s;
+      if (T_s_max_ms.has_value())
+      {
+        const float T_s_max_s = T_s_max_ms.value() * 1e-3f;
+        auto T_adsr_s = T_a_s + T_d_s + T_s_max_s + T_r_s;
+        if (T_adsr_s < T_dur_s)
+        {
+          t_ad = T_a_s;
+          t_ds = t_ad + T_d_s;
+          t_sr = t_ds + T_s_max_s;
+          t_r = t_sr + T_r_s;
+        }
+      }
+      
+      const float dt = 1.f/sample_rate;
+      // Attack includes its start time, the other segments only their end time.
+      // A segment of zero length leaves the sample at its start time to the next segment
+      // so that e.g. an attack time of zero starts directly on the decay curve.
+      auto f_end = [&](float t0, float t1, size_t begin)
+      {
+        return t1 <= t0 ? begin : first_index_after(t1, dt, begin, num_samples);
+      };
+      const size_t i_ad = f_end(t_a, t_ad, 0);
+      const size_t i_ds = f_end(t_ad, t_ds, i_ad);
+      const size_t i_sr = f_end(t_ds, t_sr, i_ds);
+      const size_t i_r = first_index_after(t_r, dt, i_sr, num_samples);
+      
+      m_segments[0] = make_segment(adsr.get_shape_A(), false, 0, i_ad, t_a, t_ad, dt,
+                                   adsr.get_level_A0(), adsr.get_level_A1());
+      m_segments[1] = make_segment(adsr.get_shape_D(), true, i_ad, i_ds, t_ad, t_ds, dt,
+                                   adsr.get_level_D0(), adsr.get_level_D1());
+      m_segments[2] = { Shape::CONST, i_ds, i_sr, adsr.get_level_S() };
+      m_segments[3] = make_segment(adsr.get_shape_R(), true, i_sr, i_r, t_sr, t_r, dt,
+                                   adsr.get_level_R0(), adsr.get_level_R1());
+      m_segments[4] = { Shape::CONST, i_r, num_samples, 0. };
+    }
+    
+    // Multiplies the envelope into buffer, which must be the note this generator was created for.
+    void apply(std::span<float> buffer) const
+    {
+      apply(buffer, 0);
+    }
+    
+    // Multiplies the envelope into a block holding the samples [offset, offset + block.size()) of the note.
+    void apply(std::span<float> block, size_t offset) const
+    {
+      for (const auto& seg : m_segments)
+        process_segment(seg, block, offset, true);
+    }
+    
+    // Writes the envelope itself to env.
+    void render(std::span<float> env) const
+    {
+      for (const auto& seg : m_segments)
+        process_segment(seg, env, 0, false);
+    }
+  
+  private:
+    enum class Shape { CONST, LIN, EXP, LOG };
+    
+    // Envelope within [begin, end) for local index k = i - begin:
+    //   CONST: c0
+    //   LIN: c0 + c1*k
+    //   EXP: c0 + c1*q, q = q0*r^k
+    //   LOG: c0 + c1*log(u0 + du*k)
+    struct Segment
+    {
+      Shape shape = Shape::CONST;
+      size_t begin = 0;
+      size_t end = 0;
+      double c0 = 0.;
+      double c1 = 0.;
+      double q0 = 1.;
+      double r = 1.;
+      double u0 = 1.;
+      double du = 0.;
+    };
+    
+    // Same float arithmetic as the time of sample i, t = i*dt, so the boundaries are exact.
+    static size_t first_index_after(float t_end, float dt, size_t i_min, size_t N)
+    {
+      double i_est = std::floor(static_cast<double>(t_end) / dt);
+      size_t i = std::clamp(static_cast<size_t>(std::max(i_est, 0.)), i_min, N);
+      while (i > i_min && static_cast<float>(i - 1) * dt > t_end)
+        --i;
+      while (i < N && static_cast<float>(i) * dt <= t_end)
+        ++i;
+      return i;
+    }
+    
+    // falling: Decay and release curves, otherwise the attack curves. In terms of the
+    // segment parameter pl = (t - t0)/(t1 - t0) and env = L0 + p*(L1 - L0):
+    //   LIN: p = pl
+    //   EXP: p = 2^pl - 1 (attack), p = 2 - 2*2^-pl (falling)
+    //   LOG: p = ln(1 + pl*(e - 1)) (attack), p = -ln(1 - pl*(1 - 1/e)) (falling)
+    static Segment make_segment(ADSRMode mode, bool falling, size_t begin, size_t end,
+                                float t0, float t1, float dt, float L0, float L1)
+    {
+      Segment seg;
+      seg.begin = begin;
+      seg.end = end;
+      const double dL = static_cast<double>(L1) - L0;
+      const double T = static_cast<double>(t1) - t0;
+      if (T <= 0.)
+      {
+        // Zero length release, i.e. only samples at t0 == t1. All curves end at p = 1.
+        seg.c0 = L1;
+        return seg;
+      }
+      const double pl0 = (static_cast<double>(static_cast<float>(begin) * dt) - t0) / T;
+      const double dpl = dt / T;
+      switch (mode)
+      {
+        case ADSRMode::LIN:
+          seg.shape = Shape::LIN;
+          seg.c0 = L0 + pl0*dL;
+          seg.c1 = dpl*dL;
+          break;
+        case ADSRMode::EXP:
+          seg.shape = Shape::EXP;
+          if (falling)
+          {
+            seg.c0 = L0 + 2.*dL;
+            seg.c1 = -2.*dL;
+            seg.q0 = std::exp2(-pl0);
+            seg.r = std::exp2(-dpl);
+          }
+          else
+          {
+            seg.c0 = L0 - dL;
+            seg.c1 = dL;
+            seg.q0 = std::exp2(pl0);
+            seg.r = std::exp2(dpl);
+          }
+          break;
+        case ADSRMode::LOG:
+          seg.shape = Shape::LOG;
+          if (falling)
+          {
+            const double a = 1. - 1./std::numbers::e;
+            seg.c0 = L0;
+            seg.c1 = -dL;
+            seg.u0 = 1. - pl0*a;
+            seg.du = -dpl*a;
+          }
+          else
+          {
+            const double a = std::numbers::e - 1.;
+            seg.c0 = L0;
+            seg.c1 = dL;
+            seg.u0 = 1. + pl0*a;
+            seg.du = dpl*a;
+          }
+          break;
+      }
+      return seg;
+    }
+    
+    void process_segment(const Segment& seg, std::span<float> buffer, size_t offset, bool multiply) const
+    {
+      const size_t begin = std::max(seg.begin, offset);
+      const size_t end = std::min(seg.end, offset + buffer.size());
+      if (begin >= end)
+        return;
+      float* x = buffer.data() + (begin - offset);
+      const size_t N = end - begin;
+      const size_t k0 = begin - seg.begin;
+      auto f_out = [multiply](float& s, double env)
+      {
+        if (multiply)
+          s *= static_cast<float>(env);
+        else
+          s = static_cast<float>(env);
+      };
+      switch (seg.shape)
+      {
+        case Shape::CONST:
+          for (size_t k = 0; k < N; ++k)
+            f_out(x[k], seg.c0);
+          break;
+        case Shape::LIN:
+          for (size_t k = 0; k < N; ++k)
+            f_out(x[k], seg.c0 + seg.c1*static_cast<double>(k0 + k));
+          break;
+        case Shape::EXP:
+        {
+          double q = k0 == 0 ? seg.q0 : seg.q0*std::pow(seg.r, static_cast<double>(k0));
+          for (size_t k = 0; k < N; ++k)
+          {
+            f_out(x[k], seg.c0 + seg.c1*q);
+            q *= seg.r;
+          }
+          break;
+        }
+        case Shape::LOG:
+          for (size_t k = 0; k < N; ++k)
+          {
+            const auto u = static_cast<float>(seg.u0 + seg.du*static_cast<double>(k0 + k));
+            f_out(x[k], seg.c0 + seg.c1*FastMath::log(u, m_math_policy));
+          }
+          break;
+      }
+    }
+    
+    std::array<Segment, 5> m_segments; // Attack, decay, sustain, release, silence.
+    MathPolicy m_math_policy = MathPolicy::PRECISE;
+  };
+  
+}
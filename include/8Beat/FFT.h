@@ -0,0 +1,491 @@
+//
+//  FFT.h
+//  8Beat
+//
+//  Created by Rasmus Anthin on 2026-10-17.
+//
+
+#pragma once
+
+#include <Core/MathUtils.h>
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <span>
+#include <vector>
+
+
+namespace beat
+{
+
+  // Precomputed twiddle factors and permutations for an in-place FFT of any size.
+  // Power-of-two sizes use an iterative radix-2/radix-4 transform, sizes whose only prime factors
+  // are 2, 3, 5 and 7 a self-sorting (Stockham) mixed-radix transform and all other sizes
+  // Bluestein's algorithm on top of a power-of-two transform.
+  // Also real-to-complex and complex-to-real transforms via a complex transform of half the size.
+  // Get plans via FFTPlan::get(), which caches one plan per size and thread.
+  class FFTPlan
+  {
+  public:
+    explicit FFTPlan(int N)
+      : m_N(N)
+    {
+      if (is_pow2(N))
+      {
+        int log2N = 0;
+        while ((1 << log2N) < N)
+          log2N++;
+        m_log2N = log2N;
+        
+        // Twiddles W_N^k = exp(-2 pi i k / N) for k in [0, N/2).
+        init_twiddles(std::max(N/2, 1));
+        
+        m_bit_reversed.resize(N);
+        for (int i = 1; i < N; ++i)
+          m_bit_reversed[i] = (m_bit_reversed[i >> 1] >> 1) | ((i & 1) << (log2N - 1));
+        m_algorithm = Algorithm::Radix2;
+      }
+      else if (is_fast_size(N))
+      {
+        // Radix-4 first as it has the cheapest butterfly.
+        int n = N;
+        for (int r : { 4, 2, 3, 5, 7 })
+          while (n % r == 0)
+          {
+            m_factors.emplace_back(r);
+            n /= r;
+          }
+        init_twiddles(N);
+        m_scratch.resize(N);
+        m_algorithm = Algorithm::MixedRadix;
+      }
+      else
+      {
+        // Twiddles are only used by the real transforms here.
+        init_twiddles(std::max(N/2, 1));
+        init_bluestein();
+        m_algorithm = Algorithm::Bluestein;
+      }
+    }
+    
+    // The cached plan for this size.
+    static FFTPlan& get(int N)
+    {
+      thread_local std::map<int, std::unique_ptr<FFTPlan>> s_plans;
+      auto& plan = s_plans[N];
+      if (plan == nullptr)
+        plan = std::make_unique<FFTPlan>(N);
+      return *plan;
+    }
+    
+    // Deep copy including the scratch buffers, e.g. for a plan of one's own that doesn't need
+    //   its twiddles recomputed. A plan must not be used by several threads at the same time.
+    FFTPlan(const FFTPlan& other)
+      : m_N(other.m_N)
+      , m_log2N(other.m_log2N)
+      , m_algorithm(other.m_algorithm)
+      , m_twiddles(other.m_twiddles)
+      , m_bit_reversed(other.m_bit_reversed)
+      , m_factors(other.m_factors)
+      , m_chirp(other.m_chirp)
+      , m_chirp_spectrum(other.m_chirp_spectrum)
+      , m_scratch(other.m_scratch)
+      , m_half_scratch(other.m_half_scratch)
+    {
+      if (other.m_bluestein_plan != nullptr)
+        m_bluestein_plan = std::make_unique<FFTPlan>(*other.m_bluestein_plan);
+      if (other.m_half_plan != nullptr)
+        m_half_plan = std::make_unique<FFTPlan>(*other.m_half_plan);
+    }
+    FFTPlan& operator=(const FFTPlan&) = delete;
+    
+    int size() const { return m_N; }
+    
+    static bool is_pow2(int n)
+    {
+      return n > 0 && (n & (n - 1)) == 0;
+    }
+    
+    // True if n only has the prime factors 2, 3, 5 and 7.
+    static bool is_fast_size(int n)
+    {
+      if (n <= 0)
+        return false;
+      for (int r : { 2, 3, 5, 7 })
+        while (n % r == 0)
+          n /= r;
+      return n == 1;
+    }
+    
+    // Smallest fast size >= n. Typically much closer to n than the next power of two.
+    static int next_fast_size(int n)
+    {
+      int m = std::max(n, 1);
+      while (!is_fast_size(m))
+        m++;
+      return m;
+    }
+    
+    // In-place forward transform. x.size() must equal size().
+    void forward(std::span<std::complex<float>> x)
+    {
+      transform(x, false);
+    }
+    
+    // In-place inverse transform without the 1/N normalization.
+    void inverse(std::span<std::complex<float>> x)
+    {
+      transform(x, true);
+    }
+    
+    // Creates the half-size plan and the scratch buffer of the real transforms. Otherwise done by
+    //   the first real transform, so call it before real-time use to not allocate there.
+    void prepare_real()
+    {
+      if (m_N < 2 || m_N % 2 != 0 || m_half_plan != nullptr)
+        return;
+      m_half_plan = std::make_unique<FFTPlan>(m_N/2);
+      m_half_scratch.resize(m_N/2);
+    }
+    
+    // Real input of size() samples to the size()/2 + 1 non-negative frequency bins. size() must be even or 1.
+    // Runs a complex transform of half the size on the even/odd samples packed as re/im.
+    void forward_real(std::span<const float> x, std::span<std::complex<float>> out)
+    {
+      const int N = m_N;
+      if (N % 2 != 0 && N != 1)
+      {
+        std::cerr << "ERROR in forward_real() : size " << N << " is odd!" << std::endl;
+        return;
+      }
+      if (N == 1)
+      {
+        out[0] = x[0];
+        return;
+      }
+      const int M = N/2;
+      prepare_real();
+      auto& z = m_half_scratch;
+      for (int n = 0; n < M; ++n)
+        z[n] = { x[2*n], x[2*n + 1] };
+      m_half_plan->forward(z);
+      
+      out[0] = z[0].real() + z[0].imag();
+      out[M] = z[0].real() - z[0].imag();
+      for (int k = 1; k < M; ++k)
+      {
+        auto zk = z[k];
+        auto zc = std::conj(z[M - k]);
+        auto even = 0.5f*(zk + zc);
+        auto odd = std::complex<float>(0.f, -0.5f)*(zk - zc);
+        out[k] = even + m_twiddles[k]*odd;
+      }
+    }
+    
+    // Inverse of forward_real() without the 1/N normalization. size() must be even or 1.
+    void inverse_real(std::span<const std::complex<float>> X, std::span<float> out)
+    {
+      const int N = m_N;
+      if (N % 2 != 0 && N != 1)
+      {
+        std::cerr << "ERROR in inverse_real() : size " << N << " is odd!" << std::endl;
+        return;
+      }
+      if (N == 1)
+      {
+        out[0] = X[0].real();
+        return;
+      }
+      const int M = N/2;
+      prepare_real();
+      auto& z = m_half_scratch;
+      for (int k = 0; k < M; ++k)
+      {
+        auto xk = X[k];
+        auto xc = std::conj(X[M - k]);
+        auto even = xk + xc;
+        auto odd = (xk - xc)*std::conj(m_twiddles[k]);
+        z[k] = even + std::complex<float>(0.f, 1.f)*odd;
+      }
+      m_half_plan->inverse(z);
+      for (int n = 0; n < M; ++n)
+      {
+        out[2*n] = z[n].real();
+        out[2*n + 1] = z[n].imag();
+      }
+    }
+  
+  private:
+    enum class Algorithm { Radix2, MixedRadix, Bluestein };
+    
+    void init_twiddles(int num)
+    {
+      m_twiddles.resize(num);
+      for (int k = 0; k < num; ++k)
+      {
+        double phi = -2.0 * math::cd_pi * k / m_N;
+        m_twiddles[k] = { static_cast<float>(std::cos(phi)), static_cast<float>(std::sin(phi)) };
+      }
+    }
+    
+    void init_bluestein()
+    {
+      // X[k] = w[k] * sum_n (x[n] w[n]) conj(w[k - n]) with the chirp w[n] = exp(-pi i n^2 / N),
+      // i.e. a linear convolution that is done via a power-of-two transform of size >= 2N - 1.
+      const int N = m_N;
+      int M = 1;
+      while (M < 2*N - 1)
+        M *= 2;
+      m_bluestein_plan = std::make_unique<FFTPlan>(M);
+      m_scratch.resize(M);
+      
+      m_chirp.resize(N);
+      for (int n = 0; n < N; ++n)
+      {
+        // n^2 mod 2N keeps the angle accurate for large n.
+        auto n2 = (static_cast<int64_t>(n) * n) % (2 * static_cast<int64_t>(N));
+        double phi = -math::cd_pi * static_cast<double>(n2) / N;
+        m_chirp[n] = { static_cast<float>(std::cos(phi)), static_cast<float>(std::sin(phi)) };
+      }
+      
+      m_chirp_spectrum.assign(M, 0.f);
+      m_chirp_spectrum[0] = std::conj(m_chirp[0]);
+      for (int n = 1; n < N; ++n)
+        m_chirp_spectrum[n] = m_chirp_spectrum[M - n] = std::conj(m_chirp[n]);
+      m_bluestein_plan->forward(m_chirp_spectrum);
+      // Fold the 1/M of the inverse transform into the kernel.
+      for (auto& z : m_chirp_spectrum)
+        z /= static_cast<float>(M);
+    }
+    
+    void transform(std::span<std::complex<float>> x, bool inverse)
+    {
+      switch (m_algorithm)
+      {
+        case Algorithm::Radix2: transform_radix2(x, inverse); break;
+        case Algorithm::MixedRadix: transform_mixed_radix(x, inverse); break;
+        case Algorithm::Bluestein: transform_bluestein(x, inverse); break;
+      }
+    }
+    
+    void transform_radix2(std::span<std::complex<float>> x, bool inverse) const
+    {
+      const int N = m_N;
+      if (N <= 1)
+        return;
+      
+      for (int i = 0; i < N; ++i)
+      {
+        int r = m_bit_reversed[i];
+        if (i < r)
+          std::swap(x[i], x[r]);
+      }
+      
+      auto f_twiddle = [this, inverse](int idx)
+      {
+        auto w = m_twiddles[idx];
+        return inverse ? std::conj(w) : w;
+      };
+      // Multiplication by -i for the forward and +i for the inverse transform.
+      auto f_rot = [inverse](const std::complex<float>& z)
+      {
+        return inverse ? std::complex<float>(-z.imag(), z.real()) : std::complex<float>(z.imag(), -z.real());
+      };
+      
+      int m = 1; // Length of the sub-transforms that are combined.
+      if (m_log2N % 2 == 1)
+      {
+        // Radix-2 stage.
+        for (int i = 0; i < N; i += 2)
+        {
+          auto a = x[i];
+          auto b = x[i + 1];
+          x[i] = a + b;
+          x[i + 1] = a - b;
+        }
+        m = 2;
+      }
+      
+      // Radix-4 stages. Each combines four sub-transforms of length m into one of length 4m.
+      for (; m < N; m *= 4)
+      {
+        const int L = 4*m;
+        const int stride_1 = N / (2*m);
+        const int stride_2 = N / L;
+        for (int j = 0; j < N; j += L)
+          for (int k = 0; k < m; ++k)
+          {
+            auto w1 = f_twiddle(k*stride_1);
+            auto w2 = f_twiddle(k*stride_2);
+            auto& x0 = x[j + k];
+            auto& x1 = x[j + k + m];
+            auto& x2 = x[j + k + 2*m];
+            auto& x3 = x[j + k + 3*m];
+            auto w1x1 = w1*x1;
+            auto w1x3 = w1*x3;
+            auto a = x0 + w1x1;
+            auto b = x0 - w1x1;
+            auto c = w2*(x2 + w1x3);
+            auto d = f_rot(w2*(x2 - w1x3));
+            x0 = a + c;
+            x2 = a - c;
+            x1 = b + d;
+            x3 = b - d;
+          }
+      }
+    }
+    
+    // Stockham decimation-in-frequency, ping-ponging between x and a scratch buffer.
+    void transform_mixed_radix(std::span<std::complex<float>> x, bool inverse)
+    {
+      const int N = m_N;
+      m_scratch.resize(N);
+      std::complex<float>* src = x.data();
+      std::complex<float>* dst = m_scratch.data();
+      int n = N; // Length of the sub-transforms left to do.
+      int s = 1; // Stride (and count) of the interleaved sub-transforms.
+      for (int r : m_factors)
+      {
+        const int m = n / r;
+        switch (r)
+        {
+          case 2: butterfly_stage<2>(src, dst, m, s, inverse); break;
+          case 3: butterfly_stage<3>(src, dst, m, s, inverse); break;
+          case 4: butterfly_stage<4>(src, dst, m, s, inverse); break;
+          case 5: butterfly_stage<5>(src, dst, m, s, inverse); break;
+          case 7: butterfly_stage<7>(src, dst, m, s, inverse); break;
+        }
+        std::swap(src, dst);
+        n = m;
+        s *= r;
+      }
+      if (src != x.data())
+        std::copy(src, src + N, x.data());
+    }
+    
+    // One radix-R pass: y[q + s(R p + k)] = W_n^(p k) * sum_j x[q + s(p + j m)] W_R^(j k), n = R m.
+    template<int R>
+    void butterfly_stage(const std::complex<float>* x, std::complex<float>* y, int m, int s, bool inverse) const
+    {
+      const float sgn = inverse ? -1.f : 1.f;
+      // Multiplication by -i for the forward and +i for the inverse transform.
+      auto f_rot = [sgn](const std::complex<float>& z)
+      {
+        return std::complex<float>(sgn*z.imag(), -sgn*z.real());
+      };
+      
+      // cos/sin(2 pi j / R) for the odd radices.
+      std::array<float, R> c {};
+      std::array<float, R> sn {};
+      for (int j = 0; j < R; ++j)
+      {
+        c[j] = m_twiddles[j * (m_N / R)].real();
+        sn[j] = -m_twiddles[j * (m_N / R)].imag();
+      }
+      
+      std::array<std::complex<float>, R> a;
+      std::array<std::complex<float>, R> b;
+      std::array<std::complex<float>, R> w;
+      for (int p = 0; p < m; ++p)
+      {
+        // s p k < N, so no wrap-around of the twiddle index.
+        for (int k = 0; k < R; ++k)
+        {
+          auto wk = m_twiddles[s * p * k];
+          w[k] = inverse ? std::conj(wk) : wk;
+        }
+        for (int q = 0; q < s; ++q)
+        {
+          for (int j = 0; j < R; ++j)
+            a[j] = x[q + s*(p + j*m)];
+          
+          if constexpr (R == 2)
+          {
+            b[0] = a[0] + a[1];
+            b[1] = a[0] - a[1];
+          }
+          else if constexpr (R == 4)
+          {
+            auto t0 = a[0] + a[2];
+            auto t1 = a[0] - a[2];
+            auto t2 = a[1] + a[3];
+            auto t3 = f_rot(a[1] - a[3]);
+            b[0] = t0 + t2;
+            b[1] = t1 + t3;
+            b[2] = t0 - t2;
+            b[3] = t1 - t3;
+          }
+          else
+          {
+            // Odd radix: pair up j and R - j so that the inner products become real.
+            constexpr int H = (R - 1) / 2;
+            std::array<std::complex<float>, H + 1> t;
+            std::array<std::complex<float>, H + 1> u;
+            b[0] = a[0];
+            for (int j = 1; j <= H; ++j)
+            {
+              t[j] = a[j] + a[R - j];
+              u[j] = a[j] - a[R - j];
+              b[0] += t[j];
+            }
+            for (int k = 1; k <= H; ++k)
+            {
+              auto re = a[0];
+              std::complex<float> im = 0.f;
+              for (int j = 1; j <= H; ++j)
+              {
+                const int jk = (j * k) % R;
+                re += c[jk] * t[j];
+                im += sn[jk] * u[j];
+              }
+              auto rim = f_rot(im);
+              b[k] = re + rim;
+              b[R - k] = re - rim;
+            }
+          }
+          
+          y[q + s*R*p] = b[0];
+          for (int k = 1; k < R; ++k)
+            y[q + s*(R*p + k)] = b[k] * w[k];
+        }
+      }
+    }
+    
+    void transform_bluestein(std::span<std::complex<float>> x, bool inverse)
+    {
+      // The inverse transform is conj(forward(conj(x))).
+      const int N = m_N;
+      const int M = m_bluestein_plan->size();
+      m_scratch.assign(M, 0.f);
+      for (int n = 0; n < N; ++n)
+        m_scratch[n] = (inverse ? std::conj(x[n]) : x[n]) * m_chirp[n];
+      m_bluestein_plan->forward(m_scratch);
+      for (int k = 0; k < M; ++k)
+        m_scratch[k] *= m_chirp_spectrum[k];
+      m_bluestein_plan->inverse(m_scratch);
+      for (int k = 0; k < N; ++k)
+      {
+        auto X = m_scratch[k] * m_chirp[k];
+        x[k] = inverse ? std::conj(X) : X;
+      }
+    }
+    
+    int m_N = 0;
+    int m_log2N = 0;
+    Algorithm m_algorithm = Algorithm::Radix2;
+    std::vector<std::complex<float>> m_twiddles;
+    std::vector<int> m_bit_reversed;
+    std::vector<int> m_factors;
+    std::vector<std::complex<float>> m_chirp;
+    std::vector<std::complex<float>> m_chirp_spectrum;
+    std::unique_ptr<FFTPlan> m_bluestein_plan;
+    std::vector<std::complex<float>> m_scratch;
+    std::unique_ptr<FFTPlan> m_half_plan;
+    std::vector<std::complex<float>> m_half_scratch;
+  };
+  
+}
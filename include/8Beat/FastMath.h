@@ -0,0 +1,437 @@
+//
+//  FastMath.h
+//  8Beat
+//
+//  Created by Rasmus Anthin on 2026-10-17.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BEAT_FASTMATH_SSE2
+#include <emmintrin.h>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BEAT_FASTMATH_AVX2
+#define BEAT_FASTMATH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#include <immintrin.h>
+#endif
+#endif
+
+
+namespace beat
+{
+
+  // PRECISE: std::sin, std::exp and std::log.
+  // FAST: The polynomial approximations in FastMath. About 1e-6 abs error for sin
+  // and 1e-6 rel error for exp and log.
+  enum class MathPolicy { PRECISE, FAST };
+  
+  // Polynomial approximations of sin, exp and log (Cephes style range reduction).
+  // The span versions use AVX2 or SSE2 when available, selected at runtime,
+  // and give the same result as the scalar versions up to rounding.
+  // sin: Accurate for |x| < 2e5, beyond that the error is in the order of the float spacing of x.
+  // exp: x is clamped to [-87.3, 88].
+  // log: x must be a finite normal float. Returns -inf for 0 and NaN for x < 0.
+  class FastMath
+  {
+  public:
+    static inline float sin(float x)
+    {
+      float y = x * c_1_pi;
+      auto k = static_cast<int32_t>(y + std::copysign(0.5f, y));
+      auto kf = static_cast<float>(k);
+      float r = ((x - kf*c_pi_1) - kf*c_pi_2) - kf*c_pi_3;
+      float r2 = r*r;
+      float p = c_sin_5;
+      p = p*r2 + c_sin_4;
+      p = p*r2 + c_sin_3;
+      p = p*r2 + c_sin_2;
+      p = p*r2 + c_sin_1;
+      float s = r + r*r2*p;
+      // Negate for odd k.
+      return std::bit_cast<float>(std::bit_cast<uint32_t>(s) ^ (static_cast<uint32_t>(k) << 31));
+    }
+    
+    static inline float exp(float x)
+    {
+      x = std::min(std::max(x, c_exp_lo), c_exp_hi);
+      float y = x * c_log2e;
+      auto n = static_cast<int32_t>(y + std::copysign(0.5f, y));
+      auto nf = static_cast<float>(n);
+      float r = (x - nf*c_ln2_1) - nf*c_ln2_2;
+      float p = c_exp_5;
+      p = p*r + c_exp_4;
+      p = p*r + c_exp_3;
+      p = p*r + c_exp_2;
+      p = p*r + c_exp_1;
+      p = p*r + c_exp_0;
+      float e = p*r*r + r + 1.f;
+      return e * std::bit_cast<float>(static_cast<uint32_t>(n + 127) << 23);
+    }
+    
+    static inline float log(float x)
+    {
+      if (!(x > 0.f))
+        return x == 0.f ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::quiet_NaN();
+      auto u = std::bit_cast<uint32_t>(x);
+      auto e = static_cast<int32_t>(u >> 23) - 126;
+      float m = std::bit_cast<float>((u & 0x007fffffu) | 0x3f000000u); // [0.5, 1).
+      if (m < c_sqrt_half)
+      {
+        e -= 1;
+        m = m + m - 1.f;
+      }
+      else
+        m = m - 1.f;
+      float z = m*m;
+      float p = c_log_8;
+      p = p*m + c_log_7;
+      p = p*m + c_log_6;
+      p = p*m + c_log_5;
+      p = p*m + c_log_4;
+      p = p*m + c_log_3;
+      p = p*m + c_log_2;
+      p = p*m + c_log_1;
+      p = p*m + c_log_0;
+      auto ef = static_cast<float>(e);
+      float l = p*m*z + ef*c_ln2_2 - 0.5f*z;
+      return (m + l) + ef*c_ln2_1;
+    }
+    
+    static inline float sin(float x, MathPolicy math_policy)
+    {
+      return math_policy == MathPolicy::FAST ? sin(x) : std::sin(x);
+    }
+    
+    static inline float exp(float x, MathPolicy math_policy)
+    {
+      return math_policy == MathPolicy::FAST ? exp(x) : std::exp(x);
+    }
+    
+    static inline float log(float x, MathPolicy math_policy)
+    {
+      return math_policy == MathPolicy::FAST ? log(x) : std::log(x);
+    }
+    
+    // out[i] = sin(x[i]). x and out may be the same span.
+    static void sin(std::span<const float> x, std::span<float> out)
+    {
+      size_t i = 0;
+      const size_t N = std::min(x.size(), out.size());
+#ifdef BEAT_FASTMATH_AVX2
+      if (has_avx2())
+        i = sin_avx2(x.data(), out.data(), N);
+#endif
+#ifdef BEAT_FASTMATH_SSE2
+      i += sin_sse2(x.data() + i, out.data() + i, N - i);
+#endif
+      for (; i < N; ++i)
+        out[i] = sin(x[i]);
+    }
+    
+    // out[i] = exp(x[i]). x and out may be the same span.
+    static void exp(std::span<const float> x, std::span<float> out)
+    {
+      size_t i = 0;
+      const size_t N = std::min(x.size(), out.size());
+#ifdef BEAT_FASTMATH_AVX2
+      if (has_avx2())
+        i = exp_avx2(x.data(), out.data(), N);
+#endif
+#ifdef BEAT_FASTMATH_SSE2
+      i += exp_sse2(x.data() + i, out.data() + i, N - i);
+#endif
+      for (; i < N; ++i)
+        out[i] = exp(x[i]);
+    }
+    
+    // out[i] = log(x[i]). x and out may be the same span.
+    static void log(std::span<const float> x, std::span<float> out)
+    {
+      size_t i = 0;
+      const size_t N = std::min(x.size(), out.size());
+#ifdef BEAT_FASTMATH_AVX2
+      if (has_avx2())
+        i = log_avx2(x.data(), out.data(), N);
+#endif
+#ifdef BEAT_FASTMATH_SSE2
+      i += log_sse2(x.data() + i, out.data() + i, N - i);
+#endif
+      for (; i < N; ++i)
+        out[i] = log(x[i]);
+    }
+    
+    static void sin(std::span<const float> x, std::span<float> out, MathPolicy math_policy)
+    {
+      if (math_policy == MathPolicy::FAST)
+        sin(x, out);
+      else
+        std::transform(x.begin(), x.end(), out.begin(), [](float v) { return std::sin(v); });
+    }
+    
+    static void exp(std::span<const float> x, std::span<float> out, MathPolicy math_policy)
+    {
+      if (math_policy == MathPolicy::FAST)
+        exp(x, out);
+      else
+        std::transform(x.begin(), x.end(), out.begin(), [](float v) { return std::exp(v); });
+    }
+    
+    static void log(std::span<const float> x, std::span<float> out, MathPolicy math_policy)
+    {
+      if (math_policy == MathPolicy::FAST)
+        log(x, out);
+      else
+        std::transform(x.begin(), x.end(), out.begin(), [](float v) { return std::log(v); });
+    }
+    
+    // True if the AVX2 kernels are used on this CPU.
+    static bool has_avx2()
+    {
+#ifdef BEAT_FASTMATH_AVX2
+      static const bool s_has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+      return s_has_avx2;
+#else
+      return false;
+#endif
+    }
+  
+  private:
+    static constexpr float c_1_pi = 0.318309886183790671538f;
+    // pi split so that k*c_pi_1 is exact for |k| < 2^16.
+    static constexpr float c_pi_1 = 3.140625f;
+    static constexpr float c_pi_2 = 9.67502593994140625e-4f;
+    static constexpr float c_pi_3 = 1.509957990978376432e-7f;
+    static constexpr float c_sin_1 = -1.66666666666666667e-1f;
+    static constexpr float c_sin_2 = 8.33333333333333333e-3f;
+    static constexpr float c_sin_3 = -1.98412698412698413e-4f;
+    static constexpr float c_sin_4 = 2.75573192239858907e-6f;
+    static constexpr float c_sin_5 = -2.50521083854417188e-8f;
+    
+    static constexpr float c_exp_lo = -87.3f;
+    static constexpr float c_exp_hi = 88.f;
+    static constexpr float c_log2e = 1.44269504088896341f;
+    static constexpr float c_ln2_1 = 0.693359375f;
+    static constexpr float c_ln2_2 = -2.12194440e-4f;
+    static constexpr float c_exp_0 = 5.0000001201e-1f;
+    static constexpr float c_exp_1 = 1.6666665459e-1f;
+    static constexpr float c_exp_2 = 4.1665795894e-2f;
+    static constexpr float c_exp_3 = 8.3334519073e-3f;
+    static constexpr float c_exp_4 = 1.3981999507e-3f;
+    static constexpr float c_exp_5 = 1.9875691500e-4f;
+    
+    static constexpr float c_sqrt_half = 0.707106781186547524f;
+    static constexpr float c_log_0 = 3.3333331174e-1f;
+    static constexpr float c_log_1 = -2.4999993993e-1f;
+    static constexpr float c_log_2 = 2.0000714765e-1f;
+    static constexpr float c_log_3 = -1.6668057665e-1f;
+    static constexpr float c_log_4 = 1.4249322787e-1f;
+    static constexpr float c_log_5 = -1.2420140846e-1f;
+    static constexpr float c_log_6 = 1.1676998740e-1f;
+    static constexpr float c_log_7 = -1.1514610310e-1f;
+    static constexpr float c_log_8 = 7.0376836292e-2f;
+
+#ifdef BEAT_FASTMATH_SSE2
+    // Rounds half away from zero, same as the scalar versions.
+    static inline __m128i round_sse2(__m128 y)
+    {
+      const __m128 sign_mask = _mm_set1_ps(-0.f);
+      __m128 half = _mm_or_ps(_mm_and_ps(y, sign_mask), _mm_set1_ps(0.5f));
+      return _mm_cvttps_epi32(_mm_add_ps(y, half));
+    }
+    
+    static size_t sin_sse2(const float* x, float* out, size_t N)
+    {
+      size_t i = 0;
+      for (; i + 4 <= N; i += 4)
+      {
+        __m128 v = _mm_loadu_ps(x + i);
+        __m128i k = round_sse2(_mm_mul_ps(v, _mm_set1_ps(c_1_pi)));
+        __m128 kf = _mm_cvtepi32_ps(k);
+        __m128 r = _mm_sub_ps(v, _mm_mul_ps(kf, _mm_set1_ps(c_pi_1)));
+        r = _mm_sub_ps(r, _mm_mul_ps(kf, _mm_set1_ps(c_pi_2)));
+        r = _mm_sub_ps(r, _mm_mul_ps(kf, _mm_set1_ps(c_pi_3)));
+        __m128 r2 = _mm_mul_ps(r, r);
+        __m128 p = _mm_set1_ps(c_sin_5);
+        p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(c_sin_4));
+        p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(c_sin_3));
+        p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(c_sin_2));
+        p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(c_sin_1));
+        __m128 s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), p));
+        __m128 sign = _mm_castsi128_ps(_mm_slli_epi32(k, 31));
+        _mm_storeu_ps(out + i, _mm_xor_ps(s, sign));
+      }
+      return i;
+    }
+    
+    static size_t exp_sse2(const float* x, float* out, size_t N)
+    {
+      size_t i = 0;
+      for (; i + 4 <= N; i += 4)
+      {
+        __m128 v = _mm_loadu_ps(x + i);
+        v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(c_exp_lo)), _mm_set1_ps(c_exp_hi));
+        __m128i n = round_sse2(_mm_mul_ps(v, _mm_set1_ps(c_log2e)));
+        __m128 nf = _mm_cvtepi32_ps(n);
+        __m128 r = _mm_sub_ps(v, _mm_mul_ps(nf, _mm_set1_ps(c_ln2_1)));
+        r = _mm_sub_ps(r, _mm_mul_ps(nf, _mm_set1_ps(c_ln2_2)));
+        __m128 p = _mm_set1_ps(c_exp_5);
+        p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(c_exp_4));
+        p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(c_exp_3));
+        p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(c_exp_2));
+        p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(c_exp_1));
+        p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(c_exp_0));
+        __m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, r), r), r), _mm_set1_ps(1.f));
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+        _mm_storeu_ps(out + i, _mm_mul_ps(e, scale));
+      }
+      return i;
+    }
+    
+    static size_t log_sse2(const float* x, float* out, size_t N)
+    {
+      size_t i = 0;
+      for (; i + 4 <= N; i += 4)
+      {
+        __m128 v = _mm_loadu_ps(x + i);
+        __m128i u = _mm_castps_si128(v);
+        __m128i e = _mm_sub_epi32(_mm_srli_epi32(u, 23), _mm_set1_epi32(126));
+        __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(u, _mm_set1_epi32(0x007fffff)),
+                                                 _mm_set1_epi32(0x3f000000)));
+        // m < sqrt(0.5): e -= 1, m = 2m - 1. Otherwise m = m - 1.
+        __m128 lt = _mm_cmplt_ps(m, _mm_set1_ps(c_sqrt_half));
+        e = _mm_add_epi32(e, _mm_castps_si128(lt));
+        m = _mm_sub_ps(_mm_add_ps(m, _mm_and_ps(m, lt)), _mm_set1_ps(1.f));
+        __m128 z = _mm_mul_ps(m, m);
+        __m128 p = _mm_set1_ps(c_log_8);
+        p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(c_log_7));
+        p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(c_log_6));
+        p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(c_log_5));
+        p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(c_log_4));
+        p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(c_log_3));
+        p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(c_log_2));
+        p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(c_log_1));
+        p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(c_log_0));
+        __m128 ef = _mm_cvtepi32_ps(e);
+        __m128 l = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, m), z), _mm_mul_ps(ef, _mm_set1_ps(c_ln2_2)));
+        l = _mm_sub_ps(l, _mm_mul_ps(_mm_set1_ps(0.5f), z));
+        __m128 res = _mm_add_ps(_mm_add_ps(m, l), _mm_mul_ps(ef, _mm_set1_ps(c_ln2_1)));
+        // x == 0: -inf. x < 0: NaN.
+        __m128 is_zero = _mm_cmpeq_ps(v, _mm_setzero_ps());
+        __m128 not_pos = _mm_cmpngt_ps(v, _mm_setzero_ps());
+        __m128 special = _mm_or_ps(_mm_and_ps(is_zero, _mm_set1_ps(-std::numeric_limits<float>::infinity())),
+                                   _mm_andnot_ps(is_zero, _mm_set1_ps(std::numeric_limits<float>::quiet_NaN())));
+        res = _mm_or_ps(_mm_and_ps(not_pos, special), _mm_andnot_ps(not_pos, res));
+        _mm_storeu_ps(out + i, res);
+      }
+      return i;
+    }
+#endif
+
+#ifdef BEAT_FASTMATH_AVX2
+    BEAT_FASTMATH_TARGET_AVX2
+    static inline __m256i round_avx2(__m256 y)
+    {
+      const __m256 sign_mask = _mm256_set1_ps(-0.f);
+      __m256 half = _mm256_or_ps(_mm256_and_ps(y, sign_mask), _mm256_set1_ps(0.5f));
+      return _mm256_cvttps_epi32(_mm256_add_ps(y, half));
+    }
+    
+    BEAT_FASTMATH_TARGET_AVX2
+    static size_t sin_avx2(const float* x, float* out, size_t N)
+    {
+      size_t i = 0;
+      for (; i + 8 <= N; i += 8)
+      {
+        __m256 v = _mm256_loadu_ps(x + i);
+        __m256i k = round_avx2(_mm256_mul_ps(v, _mm256_set1_ps(c_1_pi)));
+        __m256 kf = _mm256_cvtepi32_ps(k);
+        __m256 r = _mm256_sub_ps(v, _mm256_mul_ps(kf, _mm256_set1_ps(c_pi_1)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(kf, _mm256_set1_ps(c_pi_2)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(kf, _mm256_set1_ps(c_pi_3)));
+        __m256 r2 = _mm256_mul_ps(r, r);
+        __m256 p = _mm256_set1_ps(c_sin_5);
+        p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(c_sin_4));
+        p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(c_sin_3));
+        p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(c_sin_2));
+        p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(c_sin_1));
+        __m256 s = _mm256_fmadd_ps(_mm256_mul_ps(r, r2), p, r);
+        __m256 sign = _mm256_castsi256_ps(_mm256_slli_epi32(k, 31));
+        _mm256_storeu_ps(out + i, _mm256_xor_ps(s, sign));
+      }
+      return i;
+    }
+    
+    BEAT_FASTMATH_TARGET_AVX2
+    static size_t exp_avx2(const float* x, float* out, size_t N)
+    {
+      size_t i = 0;
+      for (; i + 8 <= N; i += 8)
+      {
+        __m256 v = _mm256_loadu_ps(x + i);
+        v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(c_exp_lo)), _mm256_set1_ps(c_exp_hi));
+        __m256i n = round_avx2(_mm256_mul_ps(v, _mm256_set1_ps(c_log2e)));
+        __m256 nf = _mm256_cvtepi32_ps(n);
+        __m256 r = _mm256_fnmadd_ps(nf, _mm256_set1_ps(c_ln2_1), v);
+        r = _mm256_fnmadd_ps(nf, _mm256_set1_ps(c_ln2_2), r);
+        __m256 p = _mm256_set1_ps(c_exp_5);
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(c_exp_4));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(c_exp_3));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(c_exp_2));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(c_exp_1));
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(c_exp_0));
+        __m256 e = _mm256_add_ps(_mm256_fmadd_ps(_mm256_mul_ps(p, r), r, r), _mm256_set1_ps(1.f));
+        __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(e, scale));
+      }
+      return i;
+    }
+    
+    BEAT_FASTMATH_TARGET_AVX2
+    static size_t log_avx2(const float* x, float* out, size_t N)
+    {
+      size_t i = 0;
+      for (; i + 8 <= N; i += 8)
+      {
+        __m256 v = _mm256_loadu_ps(x + i);
+        __m256i u = _mm256_castps_si256(v);
+        __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(u, 23), _mm256_set1_epi32(126));
+        __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(u, _mm256_set1_epi32(0x007fffff)),
+                                                       _mm256_set1_epi32(0x3f000000)));
+        __m256 lt = _mm256_cmp_ps(m, _mm256_set1_ps(c_sqrt_half), _CMP_LT_OQ);
+        e = _mm256_add_epi32(e, _mm256_castps_si256(lt));
+        m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(m, lt)), _mm256_set1_ps(1.f));
+        __m256 z = _mm256_mul_ps(m, m);
+        __m256 p = _mm256_set1_ps(c_log_8);
+        p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(c_log_7));
+        p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(c_log_6));
+        p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(c_log_5));
+        p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(c_log_4));
+        p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(c_log_3));
+        p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(c_log_2));
+        p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(c_log_1));
+        p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(c_log_0));
+        __m256 ef = _mm256_cvtepi32_ps(e);
+        __m256 l = _mm256_fmadd_ps(_mm256_mul_ps(p, m), z, _mm256_mul_ps(ef, _mm256_set1_ps(c_ln2_2)));
+        l = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, l);
+        __m256 res = _mm256_fmadd_ps(ef, _mm256_set1_ps(c_ln2_1), _mm256_add_ps(m, l));
+        __m256 is_zero = _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_EQ_OQ);
+        __m256 not_pos = _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_NGT_UQ);
+        __m256 special = _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<float>::quiet_NaN()),
+                                          _mm256_set1_ps(-std::numeric_limits<float>::infinity()), is_zero);
+        res = _mm256_blendv_ps(res, special, not_pos);
+        _mm256_storeu_ps(out + i, res);
+      }
+      return i;
+    }
+#endif
+  };
+  
+}
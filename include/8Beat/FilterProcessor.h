@@ -0,0 +1,362 @@
+//
+//  FilterProcessor.h
+//  8Beat
+//
+//  Created by Rasmus Anthin on 2026-10-17.
+//
+
+#pragma once
+
+#include "FastMath.h"
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <span>
+#include <vector>
+
+
+namespace beat
+{
+
+  struct Filter
+  {
+    std::vector<float> a;
+    std::vector<float> b;
+  };
+  
+  // Second-order section (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2).
+  struct Biquad
+  {
+    float b0 = 1.f;
+    float b1 = 0.f;
+    float b2 = 0.f;
+    float a1 = 0.f;
+    float a2 = 0.f;
+  };
+  
+  // Cascade of second-order sections. Numerically robust also for high orders.
+  struct FilterSOS
+  {
+    std::vector<Biquad> sections;
+  };
+  
+  // Delay line memory of a FilterProcessor.
+  struct FilterState
+  {
+    std::vector<float> x_hist; // x[n-1], x[n-2], ... for a Filter.
+    std::vector<float> y_hist; // y[n-1], y[n-2], ... for a Filter.
+    std::vector<std::array<float, 2>> sections; // Transposed direct form II state per Biquad.
+    
+    void reset()
+    {
+      std::fill(x_hist.begin(), x_hist.end(), 0.f);
+      std::fill(y_hist.begin(), y_hist.end(), 0.f);
+      std::fill(sections.begin(), sections.end(), std::array<float, 2> { 0.f, 0.f });
+    }
+  };
+  
+  // Runs a Filter or FilterSOS over a stream block by block, carrying the state over
+  // between the blocks. Gives the same output as filtering the whole stream at once.
+  class FilterProcessor
+  {
+  public:
+    FilterProcessor() = default;
+    FilterProcessor(const Filter& filter) { set_filter(filter); }
+    FilterProcessor(const FilterSOS& filter) { set_filter(filter); }
+    
+    // Changes the coefficients but keeps as much of the state as the new filter uses,
+    // so that e.g. consecutive notes of a voice can continue on the same filter memory.
+    void set_filter(const Filter& filter)
+    {
+      m_filter = filter;
+      if (m_filter.a.empty())
+        m_filter.a = { 1.f };
+      m_use_sos = false;
+      m_state.x_hist.resize(std::max<size_t>(m_filter.b.size(), 1) - 1, 0.f);
+      m_state.y_hist.resize(m_filter.a.size() - 1, 0.f);
+      m_state.sections.clear();
+    }
+    
+    void set_filter(const FilterSOS& filter)
+    {
+      m_filter_sos = filter;
+      m_use_sos = true;
+      m_state.sections.resize(m_filter_sos.sections.size(), { 0.f, 0.f });
+      m_state.x_hist.clear();
+      m_state.y_hist.clear();
+    }
+    
+    // in and out may be the same span. Processes min(in.size(), out.size()) samples.
+    void process(std::span<const float> in, std::span<float> out)
+    {
+      const auto N = std::min(in.size(), out.size());
+      if (m_use_sos)
+        process_sos(in.data(), out.data(), N);
+      else
+        process_tf(in.data(), out.data(), N);
+    }
+    
+    float process(float x)
+    {
+      float y = 0.f;
+      process(std::span<const float> { &x, 1 }, std::span<float> { &y, 1 });
+      return y;
+    }
+    
+    void reset() { m_state.reset(); }
+    
+    const FilterState& get_state() const { return m_state; }
+    // The state must stem from a processor with a filter of the same order.
+    void set_state(const FilterState& state) { m_state = state; }
+  
+  private:
+    // Direct form I, same arithmetic as a whole-buffer pass.
+    void process_tf(const float* in, float* out, size_t N)
+    {
+      const auto& b = m_filter.b;
+      const auto& a = m_filter.a;
+      auto& x_hist = m_state.x_hist;
+      auto& y_hist = m_state.y_hist;
+      for (size_t n = 0; n < N; ++n)
+      {
+        const float xn = in[n];
+        float yn = 0.f;
+        if (!b.empty())
+          yn += b[0] * xn;
+        for (size_t i = 1; i < b.size(); ++i)
+          yn += b[i] * x_hist[i - 1];
+        for (size_t i = 1; i < a.size(); ++i)
+          yn -= a[i] * y_hist[i - 1];
+        yn /= a[0];
+        
+        if (!x_hist.empty())
+        {
+          std::copy_backward(x_hist.begin(), x_hist.end() - 1, x_hist.end());
+          x_hist[0] = xn;
+        }
+        if (!y_hist.empty())
+        {
+          std::copy_backward(y_hist.begin(), y_hist.end() - 1, y_hist.end());
+          y_hist[0] = yn;
+        }
+        out[n] = yn;
+      }
+    }
+    
+    // One pass over the block per section keeps the coefficients and state in registers.
+    void process_sos(const float* in, float* out, size_t N)
+    {
+      if (in != out)
+        std::copy(in, in + N, out);
+      for (size_t s = 0; s < m_filter_sos.sections.size(); ++s)
+      {
+        const auto sec = m_filter_sos.sections[s];
+        auto [s1, s2] = m_state.sections[s];
+        for (size_t n = 0; n < N; ++n)
+        {
+          const float xn = out[n];
+          const float yn = sec.b0 * xn + s1;
+          s1 = sec.b1 * xn - sec.a1 * yn + s2;
+          s2 = sec.b2 * xn - sec.a2 * yn;
+          out[n] = yn;
+        }
+        m_state.sections[s] = { s1, s2 };
+      }
+    }
+    
+    Filter m_filter;
+    FilterSOS m_filter_sos;
+    bool m_use_sos = false;
+    FilterState m_state;
+  };
+  
+  // Runs up to c_max_lanes independent FilterSOS cascades side by side, one per SIMD lane,
+  // e.g. one per voice or channel. Each lane has its own coefficients and state.
+  // Lanes with fewer sections are padded with pass-through sections.
+  class MultiLaneFilterProcessor
+  {
+  public:
+    static constexpr int c_max_lanes = 8;
+    
+    explicit MultiLaneFilterProcessor(const std::vector<FilterSOS>& filters)
+      : m_num_lanes(std::min(static_cast<int>(filters.size()), c_max_lanes))
+    {
+      if (filters.empty())
+        std::cerr << "ERROR in MultiLaneFilterProcessor() : no filters given!" << std::endl;
+      size_t num_sections = 0;
+      for (int l = 0; l < m_num_lanes; ++l)
+        num_sections = std::max(num_sections, filters[l].sections.size());
+      m_coeffs.resize(num_sections);
+      m_state.resize(num_sections);
+      for (int l = 0; l < m_num_lanes; ++l)
+        set_filter(l, filters[l]);
+    }
+    
+    int num_lanes() const { return m_num_lanes; }
+    
+    // Keeps the state of the lane. The number of sections must not exceed the one given at construction.
+    void set_filter(int lane, const FilterSOS& filter)
+    {
+      for (size_t s = 0; s < m_coeffs.size(); ++s)
+      {
+        Biquad sec = s < filter.sections.size() ? filter.sections[s] : Biquad {};
+        auto& c = m_coeffs[s];
+        c[0][lane] = sec.b0;
+        c[1][lane] = sec.b1;
+        c[2][lane] = sec.b2;
+        c[3][lane] = sec.a1;
+        c[4][lane] = sec.a2;
+      }
+    }
+    
+    // Planar buffers, one per lane. in[l] and out[l] may be the same buffer.
+    // Lanes shorter than the longest one are zero padded, which also advances their state.
+    void process(std::span<const std::span<const float>> in, std::span<const std::span<float>> out)
+    {
+      const int num_lanes = std::min({ m_num_lanes, static_cast<int>(in.size()), static_cast<int>(out.size()) });
+      size_t N = 0;
+      for (int l = 0; l < num_lanes; ++l)
+        N = std::max(N, std::min(in[l].size(), out[l].size()));
+      for (size_t start = 0; start < N; start += c_block_size)
+      {
+        const size_t len = std::min(c_block_size, N - start);
+        for (size_t n = 0; n < len; ++n)
+          for (int l = 0; l < c_max_lanes; ++l)
+            m_block[n][l] = l < num_lanes && start + n < in[l].size() ? in[l][start + n] : 0.f;
+        process_block(len);
+        for (int l = 0; l < num_lanes; ++l)
+        {
+          const size_t len_l = std::min(len, out[l].size() - std::min(out[l].size(), start));
+          for (size_t n = 0; n < len_l; ++n)
+            out[l][start + n] = m_block[n][l];
+        }
+      }
+    }
+    
+    // Interleaved frames of num_lanes() samples, e.g. stereo LRLR... in and out may be the same buffer.
+    void process_interleaved(std::span<const float> in, std::span<float> out)
+    {
+      if (m_num_lanes == 0)
+      {
+        std::cerr << "ERROR in process_interleaved() : processor has no lanes!" << std::endl;
+        return;
+      }
+      const size_t num_frames = std::min(in.size(), out.size()) / m_num_lanes;
+      for (size_t start = 0; start < num_frames; start += c_block_size)
+      {
+        const size_t len = std::min(c_block_size, num_frames - start);
+        for (size_t n = 0; n < len; ++n)
+          for (int l = 0; l < c_max_lanes; ++l)
+            m_block[n][l] = l < m_num_lanes ? in[(start + n)*m_num_lanes + l] : 0.f;
+        process_block(len);
+        for (size_t n = 0; n < len; ++n)
+          for (int l = 0; l < m_num_lanes; ++l)
+            out[(start + n)*m_num_lanes + l] = m_block[n][l];
+      }
+    }
+    
+    void reset()
+    {
+      for (auto& st : m_state)
+        for (auto& v : st)
+          v.fill(0.f);
+    }
+  
+  private:
+    static constexpr size_t c_block_size = 256;
+    using Lanes = std::array<float, c_max_lanes>;
+    
+    void process_block(size_t N)
+    {
+      for (size_t s = 0; s < m_coeffs.size(); ++s)
+      {
+#ifdef BEAT_FASTMATH_AVX2
+        if (FastMath::has_avx2())
+        {
+          process_section_avx2(m_coeffs[s], m_state[s], N);
+          continue;
+        }
+#endif
+#ifdef BEAT_FASTMATH_SSE2
+        process_section_sse2(m_coeffs[s], m_state[s], N);
+#else
+        process_section_scalar(m_coeffs[s], m_state[s], N);
+#endif
+      }
+    }
+    
+    // Same arithmetic as FilterProcessor, lane by lane.
+    void process_section_scalar(const std::array<Lanes, 5>& c, std::array<Lanes, 2>& st, size_t N)
+    {
+      for (size_t n = 0; n < N; ++n)
+        for (int l = 0; l < c_max_lanes; ++l)
+        {
+          const float xn = m_block[n][l];
+          const float yn = c[0][l] * xn + st[0][l];
+          st[0][l] = c[1][l] * xn - c[3][l] * yn + st[1][l];
+          st[1][l] = c[2][l] * xn - c[4][l] * yn;
+          m_block[n][l] = yn;
+        }
+    }
+
+#ifdef BEAT_FASTMATH_SSE2
+    void process_section_sse2(const std::array<Lanes, 5>& c, std::array<Lanes, 2>& st, size_t N)
+    {
+      const int num_halves = m_num_lanes > 4 ? 2 : 1;
+      for (int h = 0; h < num_halves; ++h)
+      {
+        const int o = 4*h;
+        const __m128 b0 = _mm_loadu_ps(&c[0][o]);
+        const __m128 b1 = _mm_loadu_ps(&c[1][o]);
+        const __m128 b2 = _mm_loadu_ps(&c[2][o]);
+        const __m128 a1 = _mm_loadu_ps(&c[3][o]);
+        const __m128 a2 = _mm_loadu_ps(&c[4][o]);
+        __m128 s1 = _mm_loadu_ps(&st[0][o]);
+        __m128 s2 = _mm_loadu_ps(&st[1][o]);
+        for (size_t n = 0; n < N; ++n)
+        {
+          const __m128 xn = _mm_loadu_ps(&m_block[n][o]);
+          const __m128 yn = _mm_add_ps(_mm_mul_ps(b0, xn), s1);
+          s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, xn), _mm_mul_ps(a1, yn)), s2);
+          s2 = _mm_sub_ps(_mm_mul_ps(b2, xn), _mm_mul_ps(a2, yn));
+          _mm_storeu_ps(&m_block[n][o], yn);
+        }
+        _mm_storeu_ps(&st[0][o], s1);
+        _mm_storeu_ps(&st[1][o], s2);
+      }
+    }
+#endif
+
+#ifdef BEAT_FASTMATH_AVX2
+    // Separate multiply and add intrinsics, but the compiler may still fuse them in this AVX2 target,
+    // so the result can differ from the other paths in the last bits.
+    BEAT_FASTMATH_TARGET_AVX2
+    void process_section_avx2(const std::array<Lanes, 5>& c, std::array<Lanes, 2>& st, size_t N)
+    {
+      const __m256 b0 = _mm256_loadu_ps(c[0].data());
+      const __m256 b1 = _mm256_loadu_ps(c[1].data());
+      const __m256 b2 = _mm256_loadu_ps(c[2].data());
+      const __m256 a1 = _mm256_loadu_ps(c[3].data());
+      const __m256 a2 = _mm256_loadu_ps(c[4].data());
+      __m256 s1 = _mm256_loadu_ps(st[0].data());
+      __m256 s2 = _mm256_loadu_ps(st[1].data());
+      for (size_t n = 0; n < N; ++n)
+      {
+        const __m256 xn = _mm256_loadu_ps(m_block[n].data());
+        const __m256 yn = _mm256_add_ps(_mm256_mul_ps(b0, xn), s1);
+        s1 = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1, xn), _mm256_mul_ps(a1, yn)), s2);
+        s2 = _mm256_sub_ps(_mm256_mul_ps(b2, xn), _mm256_mul_ps(a2, yn));
+        _mm256_storeu_ps(m_block[n].data(), yn);
+      }
+      _mm256_storeu_ps(st[0].data(), s1);
+      _mm256_storeu_ps(st[1].data(), s2);
+    }
+#endif
+    
+    int m_num_lanes = 0;
+    std::vector<std::array<Lanes, 5>> m_coeffs; // b0, b1, b2, a1, a2 per section.
+    std::vector<std::array<Lanes, 2>> m_state; // s1, s2 per section.
+    std::array<Lanes, c_block_size> m_block; // Frames of c_max_lanes samples.
+  };
+  
+}
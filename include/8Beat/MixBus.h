@@ -0,0 +1,125 @@
+//
+//  MixBus.h
+//  8Beat
+//
+//  Created by Rasmus Anthin on 2026-10-17.
+//
+
+#pragma once
+
+#include "FastMath.h"
+#include <algorithm>
+#include <span>
+#include <vector>
+
+
+namespace beat
+{
+
+  // One input of a MixBus. The samples are not copied and must outlive the bus.
+  struct MixInput
+  {
+    std::span<const float> samples;
+    float weight = 1.f;
+    size_t offset = 0; // Output index of samples[0].
+  };
+  
+  // Sums any number of weighted inputs in one streaming pass over the output, block by block
+  // so that the output block stays in the L1 cache while all the inputs are added to it.
+  class MixBus
+  {
+  public:
+    static constexpr size_t c_block_size = 1024;
+    
+    MixBus& add_input(std::span<const float> samples, float weight = 1.f, size_t offset = 0)
+    {
+      m_inputs.push_back({ samples, weight, offset });
+      m_weight_sum += weight;
+      return *this;
+    }
+    
+    void clear()
+    {
+      m_inputs.clear();
+      m_weight_sum = 0.f;
+    }
+    
+    const std::vector<MixInput>& get_inputs() const { return m_inputs; }
+    float get_weight_sum() const { return m_weight_sum; }
+    
+    // Number of output samples until the end of the shortest input,
+    // or of the longest input if pad_to_longest is true. Offsets included.
+    size_t length(bool pad_to_longest = false) const
+    {
+      if (m_inputs.empty())
+        return 0;
+      size_t N = pad_to_longest ? 0 : static_cast<size_t>(-1);
+      for (const auto& in : m_inputs)
+      {
+        const size_t end = in.offset + in.samples.size();
+        N = pad_to_longest ? std::max(N, end) : std::min(N, end);
+      }
+      return N;
+    }
+    
+    // out[i] = sum_j weight_j * input_j[start + i - offset_j], where an input without a sample
+    // at that index counts as zero. start: Output index of out[0], for mixing block by block.
+    // weighted_average: Divides the sum by the sum of all the weights.
+    void mix(std::span<float> out, size_t start = 0, bool weighted_average = false) const
+    {
+      for (size_t b = 0; b < out.size(); b += c_block_size)
+      {
+        auto block = out.subspan(b, std::min(c_block_size, out.size() - b));
+        std::fill(block.begin(), block.end(), 0.f);
+        const size_t pos = start + b;
+        for (const auto& in : m_inputs)
+        {
+          const size_t end = in.offset + in.samples.size();
+          if (pos + block.size() <= in.offset || pos >= end)
+            continue;
+          const size_t i0 = in.offset > pos ? in.offset - pos : 0;
+          const size_t i1 = std::min(block.size(), end - pos);
+          accumulate(block.subspan(i0, i1 - i0), in.samples.subspan(pos + i0 - in.offset), in.weight);
+        }
+        if (weighted_average)
+          for (auto& s : block)
+            s /= m_weight_sum;
+      }
+    }
+    
+    // y[i] += weight * x[i] for i in [0, y.size()). x.size() must be >= y.size().
+    // Separate multiply and add, so the result is the same with and without SIMD. No AVX2 path since
+    // the loop is bound by memory bandwidth and the compiler would fuse the multiply-add there.
+    static void accumulate(std::span<float> y, std::span<const float> x, float weight)
+    {
+      const size_t N = y.size();
+      size_t i = 0;
+#ifdef BEAT_FASTMATH_SSE2
+      i = accumulate_sse2(y.data(), x.data(), weight, N);
+#endif
+      for (; i < N; ++i)
+        y[i] += weight * x[i];
+    }
+  
+  private:
+#ifdef BEAT_FASTMATH_SSE2
+    static size_t accumulate_sse2(float* y, const float* x, float weight, size_t N)
+    {
+      const __m128 w = _mm_set1_ps(weight);
+      size_t i = 0;
+      for (; i + 8 <= N; i += 8)
+      {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(w, _mm_loadu_ps(x + i))));
+        _mm_storeu_ps(y + i + 4, _mm_add_ps(_mm_loadu_ps(y + i + 4), _mm_mul_ps(w, _mm_loadu_ps(x + i + 4))));
+      }
+      for (; i + 4 <= N; i += 4)
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(w, _mm_loadu_ps(x + i))));
+      return i;
+    }
+#endif
+    
+    std::vector<MixInput> m_inputs;
+    float m_weight_sum = 0.f;
+  };
+  
+}
@@ -0,0 +1,134 @@
+//
+//  PRNG.h
+//  8Beat
+//
+//  Created by Rasmus Anthin on 2026-10-17.
+//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+
+namespace beat
+{
+
+  // Seedable pseudo random number generator based on xoshiro128+.
+  // Runs c_num_lanes independent streams side by side so that fill() vectorizes.
+  // The output sequence is the lanes interleaved and does not depend on
+  // whether the numbers are drawn via rand() or fill().
+  class PRNG
+  {
+  public:
+    static constexpr int c_num_lanes = 8;
+    
+    explicit PRNG(uint64_t seed = 0)
+    {
+      set_seed(seed);
+    }
+    
+    void set_seed(uint64_t seed)
+    {
+      // Expand the seed into the lane states with splitmix64.
+      auto f_splitmix64 = [&seed]()
+      {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+      };
+      for (int l = 0; l < c_num_lanes; ++l)
+      {
+        uint64_t a = f_splitmix64();
+        uint64_t b = f_splitmix64();
+        m_s0[l] = static_cast<uint32_t>(a);
+        m_s1[l] = static_cast<uint32_t>(a >> 32);
+        m_s2[l] = static_cast<uint32_t>(b);
+        m_s3[l] = static_cast<uint32_t>(b >> 32);
+        if ((m_s0[l] | m_s1[l] | m_s2[l] | m_s3[l]) == 0)
+          m_s0[l] = 1;
+      }
+      m_buf_idx = c_num_lanes;
+    }
+    
+    // [0, 1).
+    float rand()
+    {
+      if (m_buf_idx == c_num_lanes)
+      {
+        step(m_buf);
+        m_buf_idx = 0;
+      }
+      return to_unit_float(m_buf[m_buf_idx++]);
+    }
+    
+    // [a, b).
+    float rand_float(float a, float b)
+    {
+      return a + (b - a)*rand();
+    }
+    
+    // Fills out with numbers in [a, b). Same as calling rand_float(a, b) for each element.
+    void fill(std::span<float> out, float a = 0.f, float b = 1.f)
+    {
+      const size_t N = out.size();
+      const float d = b - a;
+      size_t i = 0;
+      while (i < N && m_buf_idx < c_num_lanes)
+        out[i++] = a + d*to_unit_float(m_buf[m_buf_idx++]);
+      
+      std::array<uint32_t, c_num_lanes> r;
+      for (; i + c_num_lanes <= N; i += c_num_lanes)
+      {
+        step(r);
+        for (int l = 0; l < c_num_lanes; ++l)
+          out[i + l] = a + d*to_unit_float(r[l]);
+      }
+      
+      if (i < N)
+      {
+        step(m_buf);
+        m_buf_idx = 0;
+        while (i < N)
+          out[i++] = a + d*to_unit_float(m_buf[m_buf_idx++]);
+      }
+    }
+  
+  private:
+    static inline float to_unit_float(uint32_t x)
+    {
+      // Upper 24 bits -> [0, 1).
+      return static_cast<float>(x >> 8) * (1.f / 16777216.f);
+    }
+    
+    static inline uint32_t rotl(uint32_t x, int k)
+    {
+      return (x << k) | (x >> (32 - k));
+    }
+    
+    void step(std::array<uint32_t, c_num_lanes>& r)
+    {
+      for (int l = 0; l < c_num_lanes; ++l)
+      {
+        r[l] = m_s0[l] + m_s3[l];
+        uint32_t t = m_s1[l] << 9;
+        m_s2[l] ^= m_s0[l];
+        m_s3[l] ^= m_s1[l];
+        m_s1[l] ^= m_s2[l];
+        m_s0[l] ^= m_s3[l];
+        m_s2[l] ^= t;
+        m_s3[l] = rotl(m_s3[l], 11);
+      }
+    }
+    
+    alignas(32) std::array<uint32_t, c_num_lanes> m_s0;
+    alignas(32) std::array<uint32_t, c_num_lanes> m_s1;
+    alignas(32) std::array<uint32_t, c_num_lanes> m_s2;
+    alignas(32) std::array<uint32_t, c_num_lanes> m_s3;
+    std::array<uint32_t, c_num_lanes> m_buf;
+    int m_buf_idx = c_num_lanes;
+  };
+  
+}
@@ -0,0 +1,236 @@
+//
+//  Resampler.h
+//  8Beat
+//
+//  Created by Rasmus Anthin on 2026-10-17.
+//
+
+#pragma once
+
+#include "FastMath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <numbers>
+#include <numeric>
+#include <span>
+#include <tuple>
+#include <vector>
+
+
+namespace beat
+{
+
+  // Length and steepness of the windowed-sinc kernel.
+  // LOW: 8 taps, MEDIUM: 16 taps, HIGH: 32 taps per input sample period (more when downsampling).
+  enum class ResamplerQuality { LOW, MEDIUM, HIGH };
+  
+  // Windowed-sinc (Kaiser) coefficients for resampling by the rational factor up/down,
+  // one row of num_taps() coefficients per phase, i.e. per fractional position between two input samples.
+  // Each row is normalized to unity DC gain. For very large up factors (e.g. 44100 -> 44101)
+  // the phases are quantized to c_max_phases rows, between which the resampler interpolates.
+  class PolyphaseTable
+  {
+  public:
+    static constexpr int c_max_phases = 1024;
+    
+    PolyphaseTable(int up, int down, ResamplerQuality quality)
+      : m_up(up)
+      , m_down(down)
+    {
+      int base_taps = 16;
+      double rolloff = 0.9;
+      double beta = 7.;
+      switch (quality)
+      {
+        case ResamplerQuality::LOW: base_taps = 8; rolloff = 0.85; beta = 5.; break;
+        case ResamplerQuality::MEDIUM: base_taps = 16; rolloff = 0.9; beta = 7.; break;
+        case ResamplerQuality::HIGH: base_taps = 32; rolloff = 0.95; beta = 9.; break;
+      }
+      // Cutoff relative to the input Nyquist frequency. When downsampling it is the output Nyquist
+      // frequency instead, and the kernel is widened by the same factor to keep the transition band.
+      const double ratio = std::min(1., static_cast<double>(up) / down);
+      const double fc = rolloff * ratio;
+      const int num_taps = static_cast<int>(std::ceil(base_taps / ratio));
+      m_num_taps = std::min((num_taps + 7) / 8 * 8, c_max_taps);
+      m_num_phases = std::min(up, c_max_phases);
+      const int num_rows = m_num_phases == up ? m_num_phases : m_num_phases + 1;
+      
+      const double half_width = m_num_taps / 2;
+      const double i0_beta = bessel_i0(beta);
+      m_coeffs.resize(static_cast<size_t>(num_rows) * m_num_taps);
+      for (int p = 0; p < num_rows; ++p)
+      {
+        float* row = m_coeffs.data() + static_cast<size_t>(p) * m_num_taps;
+        double sum = 0.;
+        std::vector<double> h(m_num_taps);
+        for (int k = 0; k < m_num_taps; ++k)
+        {
+          // Distance in input samples from tap k to the output position.
+          const double d = static_cast<double>(p) / m_num_phases + (half_width - 1.) - k;
+          const double x = d / half_width;
+          const double w = std::abs(x) >= 1. ? 0. : bessel_i0(beta * std::sqrt(1. - x*x)) / i0_beta;
+          const double arg = std::numbers::pi * fc * d;
+          const double sinc = std::abs(arg) < 1e-12 ? 1. : std::sin(arg) / arg;
+          h[k] = fc * sinc * w;
+          sum += h[k];
+        }
+        for (int k = 0; k < m_num_taps; ++k)
+          row[k] = static_cast<float>(h[k] / sum);
+      }
+    }
+    
+    // Tables are immutable and shared between resamplers, one per ratio and quality and thread.
+    static std::shared_ptr<const PolyphaseTable> get(int up, int down, ResamplerQuality quality)
+    {
+      thread_local std::map<std::tuple<int, int, ResamplerQuality>, std::shared_ptr<const PolyphaseTable>> s_tables;
+      auto& table = s_tables[{ up, down, quality }];
+      if (table == nullptr)
+        table = std::make_shared<const PolyphaseTable>(up, down, quality);
+      return table;
+    }
+    
+    int up() const { return m_up; }
+    int down() const { return m_down; }
+    int num_taps() const { return m_num_taps; }
+    int num_phases() const { return m_num_phases; }
+    bool is_exact() const { return m_num_phases == m_up; }
+    const float* row(int phase) const { return m_coeffs.data() + static_cast<size_t>(phase) * m_num_taps; }
+  
+  private:
+    static constexpr int c_max_taps = 1024;
+    
+    // Modified Bessel function of the first kind, order 0.
+    static double bessel_i0(double x)
+    {
+      double sum = 1.;
+      double term = 1.;
+      const double x_half_sq = x*x / 4.;
+      for (int k = 1; k < 50 && term > 1e-12 * sum; ++k)
+      {
+        term *= x_half_sq / (static_cast<double>(k) * k);
+        sum += term;
+      }
+      return sum;
+    }
+    
+    int m_up = 1;
+    int m_down = 1;
+    int m_num_taps = 8;
+    int m_num_phases = 1;
+    std::vector<float> m_coeffs;
+  };
+  
+  // Polyphase FIR resampler from sample_rate_in to sample_rate_out. Keeps its state between
+  // calls to process(), so a stream can be resampled block by block.
+  // The output sample n is taken at input position n * sample_rate_in / sample_rate_out.
+  class Resampler
+  {
+  public:
+    Resampler(int sample_rate_in, int sample_rate_out, ResamplerQuality quality = ResamplerQuality::MEDIUM)
+    {
+      const int g = std::gcd(sample_rate_in, sample_rate_out);
+      m_table = PolyphaseTable::get(sample_rate_out / g, sample_rate_in / g, quality);
+      reset();
+    }
+    
+    // Resamples the next block of the input stream and appends the output samples to out.
+    // The output lags behind by half the kernel length, which flush() drains at the end of the stream.
+    void process(std::span<const float> in, std::vector<float>& out)
+    {
+      m_buffer.insert(m_buffer.end(), in.begin(), in.end());
+      m_num_in += in.size();
+      produce(out, static_cast<uint64_t>(-1));
+      m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_first_tap);
+      m_first_tap = 0;
+    }
+    
+    // Ends the stream with num_out_total(num_in) output samples in total and resets the resampler.
+    void flush(std::vector<float>& out)
+    {
+      m_buffer.insert(m_buffer.end(), m_table->num_taps(), 0.f);
+      produce(out, num_out_total(m_num_in));
+      reset();
+    }
+    
+    void reset()
+    {
+      // Zeros before the first input sample.
+      m_buffer.assign(m_table->num_taps() / 2 - 1, 0.f);
+      m_first_tap = 0;
+      m_phase = 0;
+      m_num_in = 0;
+      m_num_out = 0;
+    }
+    
+    // floor(num_in * sample_rate_out / sample_rate_in).
+    uint64_t num_out_total(uint64_t num_in) const
+    {
+      return num_in * m_table->up() / m_table->down();
+    }
+    
+    int num_taps() const { return m_table->num_taps(); }
+  
+  private:
+    void produce(std::vector<float>& out, uint64_t max_num_out)
+    {
+      const auto& table = *m_table;
+      const size_t K = table.num_taps();
+      const int64_t up = table.up();
+      const int64_t down = table.down();
+      const int64_t P = table.num_phases();
+      while (m_num_out < max_num_out && m_first_tap + K <= m_buffer.size())
+      {
+        const float* x = m_buffer.data() + m_first_tap;
+        if (table.is_exact())
+          out.emplace_back(dot(x, table.row(static_cast<int>(m_phase)), K));
+        else
+        {
+          const int64_t u = m_phase * P;
+          const auto row = static_cast<int>(u / up);
+          const float frac = static_cast<float>(u % up) / static_cast<float>(up);
+          const float y0 = dot(x, table.row(row), K);
+          const float y1 = dot(x, table.row(row + 1), K);
+          out.emplace_back(y0 + frac*(y1 - y0));
+        }
+        m_num_out++;
+        m_phase += down;
+        m_first_tap += static_cast<size_t>(m_phase / up);
+        m_phase %= up;
+      }
+    }
+    
+    // K is a multiple of 8.
+    static float dot(const float* x, const float* h, size_t K)
+    {
+      size_t k = 0;
+      float acc = 0.f;
+#ifdef BEAT_FASTMATH_SSE2
+      __m128 a0 = _mm_setzero_ps();
+      __m128 a1 = _mm_setzero_ps();
+      for (; k + 8 <= K; k += 8)
+      {
+        a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(h + k)));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(x + k + 4), _mm_loadu_ps(h + k + 4)));
+      }
+      a0 = _mm_add_ps(a0, a1);
+      a0 = _mm_add_ps(a0, _mm_movehl_ps(a0, a0));
+      a0 = _mm_add_ss(a0, _mm_shuffle_ps(a0, a0, 1));
+      acc = _mm_cvtss_f32(a0);
+#endif
+      for (; k < K; ++k)
+        acc += x[k] * h[k];
+      return acc;
+    }
+    
+    std::shared_ptr<const PolyphaseTable> m_table;
+    std::vector<float> m_buffer; // Inputs from the first tap of the next output sample.
+    size_t m_first_tap = 0;
+    int64_t m_phase = 0; // In units of 1/up input samples.
+    uint64_t m_num_in = 0;
+    uint64_t m_num_out = 0;
+  };
+  
+}
@@ -53,11 +53,11 @@ namespace beat
           
           wd = wave_gen.generate_waveform(WaveformType::TRIANGLE, 0.5f*vp(3), 1369.f*vp(4),
                                           params, 44100, false);
-          wd = WaveformHelper::envelope_adsr(wd,
-                                             Attack { ADSRMode::LIN, 50*vp(5), 0.f, 0.2f*vp(8) },
-                                             Decay { ADSRMode::LIN, 100*vp(6), 1.f},
-                                             Sustain { 0.4f*vp(9) },
-                                             Release { ADSRMode::EXP, 150*vp(7) });
+          WaveformHelper::apply_envelope_adsr(wd,
+                                              Attack { ADSRMode::LIN, 50*vp(5), 0.f, 0.2f*vp(8) },
+                                              Decay { ADSRMode::LIN, 100*vp(6), 1.f},
+                                              Sustain { 0.4f*vp(9) },
+                                              Release { ADSRMode::EXP, 150*vp(7) });
           return wd;
         case SFXType::LASER:
           if (verbose && variation_params.size() > 12)
@@ -69,16 +69,16 @@ namespace beat
           
           wd = wave_gen.generate_waveform(WaveformType::SQUARE, 0.2f*vp(3), 968.6f*vp(4),
                                           params, 44100, false);
-          wd = WaveformHelper::envelope_adsr(wd,
-                                             Attack { ADSRMode::LIN, 0, 0.f, 0.2f*vp(7) },
-                                             Decay { ADSRMode::LIN, 20*vp(5), 1.f},
-                                             Sustain { 0.4f*vp(8) },
-                                             Release { ADSRMode::EXP, 13*vp(6) });
+          WaveformHelper::apply_envelope_adsr(wd,
+                                              Attack { ADSRMode::LIN, 0, 0.f, 0.2f*vp(7) },
+                                              Decay { ADSRMode::LIN, 20*vp(5), 1.f},
+                                              Sustain { 0.4f*vp(8) },
+                                              Release { ADSRMode::EXP, 13*vp(6) });
           {
             float delay_time = 3e-3f*vp(9);
             float rate = 0.9f*vp(10);
             float feedback = 0.9f*vp(11);
-            wd = WaveformHelper::flanger(wd, delay_time, rate, feedback);
+            WaveformHelper::apply_flanger(wd, delay_time, rate, feedback);
           }
           return wd;
         case SFXType::EXPLOSION:
@@ -99,14 +99,14 @@ namespace beat
             float delay_time = 1e-3f*vp(9);
             float rate = 0.7f*vp(10);
             float feedback = 0.4f*vp(11);
-            wd = WaveformHelper::flanger(wd, delay_time, rate, feedback);
+            WaveformHelper::apply_flanger(wd, delay_time, rate, feedback);
           }
           
-          wd = WaveformHelper::envelope_adsr(wd,
-                                             Attack { ADSRMode::LIN, 10*vp(12), 0.f, 0.2f*vp(15) },
-                                             Decay { ADSRMode::LIN, 50*vp(13), 1.f },
-                                             Sustain { 0.6f*vp(16) },
-                                             Release { ADSRMode::LIN, 340*vp(14) });
+          WaveformHelper::apply_envelope_adsr(wd,
+                                              Attack { ADSRMode::LIN, 10*vp(12), 0.f, 0.2f*vp(15) },
+                                              Decay { ADSRMode::LIN, 50*vp(13), 1.f },
+                                              Sustain { 0.6f*vp(16) },
+                                              Release { ADSRMode::LIN, 340*vp(14) });
           
           WaveformHelper::normalize(wd);
           return wd;
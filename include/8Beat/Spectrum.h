@@ -20,11 +20,23 @@ namespace beat
     std::vector<std::complex<float>> buffer;
     float freq_start = 0.f;
     float freq_end = 0.f;
+    // If true, buffer holds the N/2 + 1 non-redundant bins (0 to Nyquist) of the
+    // spectrum of a real signal of length N. N is even (or 1 if buffer has one bin).
+    bool half_spectrum = false;
     
     void copy_properties(const Spectrum& spectrum)
     {
       this->freq_start = spectrum.freq_start;
       this->freq_end = spectrum.freq_end;
+      this->half_spectrum = spectrum.half_spectrum;
+    }
+    
+    // Length of the signal the spectrum was computed from.
+    size_t signal_length() const
+    {
+      if (half_spectrum)
+        return buffer.size() <= 1 ? buffer.size() : 2*(buffer.size() - 1);
+      return buffer.size();
     }
   };
 
@@ -9,6 +9,7 @@
 
 #include "WaveformGeneration.h"
 #include "WaveformHelper.h"
+#include "EffectChain.h"
 
 
 namespace beat
@@ -50,11 +51,36 @@ namespace beat
       }
     }
     
+    // Mix, envelope, filter and clamp run as one EffectChain pass. Boost and normalization need the whole wave.
     static Waveform synthesize(const std::vector<std::pair<float, Waveform>>& wave_comp, const ADSR& adsr, const FilterArgs& final_filter_args, bool final_boost, bool final_normalize)
     {
-      auto wave = WaveformHelper::mix(wave_comp);
-      wave = WaveformHelper::envelope_adsr(wave, adsr);
-      wave = WaveformHelper::filter(wave, final_filter_args);
+      Waveform wave;
+      int common_sample_rate = 0;
+      float frequency = 0.f;
+      MixBus bus;
+      for (const auto& [weight, comp] : wave_comp)
+      {
+        math::maximize(common_sample_rate, comp.sample_rate);
+        frequency += comp.frequency;
+        bus.add_input(comp.buffer, weight);
+      }
+      wave.buffer.resize(bus.length());
+      wave.sample_rate = common_sample_rate;
+      wave.frequency = frequency / wave_comp.size();
+      wave.update_duration();
+      
+      EffectChain chain;
+      chain.add_mix(bus, true);
+      chain.add_envelope(EnvelopeGenerator(adsr, wave.duration, wave.sample_rate, wave.buffer.size()));
+      if (final_filter_args.filter_type != FilterType::NONE)
+      {
+        chain.add_filter(WaveformHelper::design_filter_sos(final_filter_args, wave.frequency, wave.sample_rate));
+        chain.add_clamp();
+      }
+      chain.process(wave.buffer);
+      
+      if (final_filter_args.filter_type != FilterType::NONE && final_filter_args.normalize_filtered_wave)
+        WaveformHelper::normalize(wave, true);
       if (final_boost)
       {
         float upper_threshold = 0.4f;//0.6f;
@@ -108,8 +134,8 @@ namespace beat
           wave_comp.emplace_back(0.3f, wave_gen.generate_waveform(WaveformType::SQUARE,
             duration_s, frequency_Hz));
           noise = wave_gen.generate_waveform(WaveformType::NOISE, duration_s);
-          noise = WaveformHelper::filter(noise, FilterType::ChebyshevTypeI, FilterOpType::LowPass, 2, 0.9f, 0.1f);
-          wave_comp.emplace_back(0.2f, noise);
+          WaveformHelper::apply_filter(noise, FilterType::ChebyshevTypeI, FilterOpType::LowPass, 2, 0.9f, 0.1f);
+          wave_comp.emplace_back(0.2f, std::move(noise));
           final_filter_args.filter_type = FilterType::NONE;
           //final_filter_args.filter_op_type = FilterOpType::LowPass;
           //final_filter_args.filter_order = 2;
@@ -137,7 +163,7 @@ namespace beat
           
           sine = wave_gen.generate_waveform(WaveformType::SINE, duration_s, 1.011f*frequency_Hz);
           WaveformHelper::scale(sine, 0.4f);
-          wave_comp.back().second = WaveformHelper::ring_modulation(wave_comp.back().second, sine);
+          WaveformHelper::apply_ring_modulation(wave_comp.back().second, sine);
           
           wave_comp.emplace_back(0.15f, wave_gen.generate_waveform(WaveformType::TRIANGLE, duration_s, 3.f*frequency_Hz));
           wave_comp.emplace_back(0.05f, wave_gen.generate_waveform(WaveformType::NOISE, duration_s, frequency_Hz));
@@ -150,19 +176,19 @@ namespace beat
             auto wdh = wave_gen.generate_waveform(WaveformType::SINE, duration_s, h * frequency_Hz,
                 params, sample_rate, verbosity,
                 frequency_effect, amplitude_effect, phase_effect);
-            wave_comp.emplace_back(0.8f*(1.f/h)/tot_harmonics_ampl, wdh);
+            wave_comp.emplace_back(0.8f*(1.f/h)/tot_harmonics_ampl, std::move(wdh));
           }
 
 #if 0
           triangle = wave_gen.generate_waveform(WaveformType::TRIANGLE, duration_s, 6.f*frequency_Hz);
-          triangle = WaveformHelper::filter(triangle, FilterType::ChebyshevTypeII, FilterOpType::LowPass, 1, 2.5f, std::nullopt, 0.1f);
+          WaveformHelper::apply_filter(triangle, FilterType::ChebyshevTypeII, FilterOpType::LowPass, 1, 2.5f, std::nullopt, 0.1f);
           wave_comp.emplace_back(0.05f, triangle);
 #endif
           
           noise = wave_gen.generate_waveform(WaveformType::NOISE,
             duration_s, std::nullopt);
-          noise = WaveformHelper::filter(noise, FilterType::ChebyshevTypeI, FilterOpType::LowPass, 2, 0.9f, 0.1f);
-          wave_comp.emplace_back(0.1f, noise);
+          WaveformHelper::apply_filter(noise, FilterType::ChebyshevTypeI, FilterOpType::LowPass, 2, 0.9f, 0.1f);
+          wave_comp.emplace_back(0.1f, std::move(noise));
           
           final_filter_args.filter_type = FilterType::Butterworth;
           final_filter_args.filter_op_type = FilterOpType::LowPass;
@@ -224,17 +250,17 @@ namespace beat
             
           // Generate the fundamental low-frequency sine wave
           auto fundamental_wave = wave_gen.generate_waveform(WaveformType::SINE, duration_s, frequency_Hz);
-          fundamental_wave = WaveformHelper::envelope_adsr(fundamental_wave, sub_adsr_1);
-          wave_comp.emplace_back(0.1f, fundamental_wave);
+          WaveformHelper::apply_envelope_adsr(fundamental_wave, sub_adsr_1);
+          wave_comp.emplace_back(0.1f, std::move(fundamental_wave));
           
           // Add some higher harmonics to enrich the sound
           auto harmonic1_wave = wave_gen.generate_waveform(WaveformType::SINE, duration_s, 2 * frequency_Hz);
-          harmonic1_wave = WaveformHelper::envelope_adsr(harmonic1_wave, sub_adsr_2);
-          wave_comp.emplace_back(0.05f, harmonic1_wave);
+          WaveformHelper::apply_envelope_adsr(harmonic1_wave, sub_adsr_2);
+          wave_comp.emplace_back(0.05f, std::move(harmonic1_wave));
           
           auto harmonic2_wave = wave_gen.generate_waveform(WaveformType::SINE, duration_s, 3 * frequency_Hz);
-          harmonic2_wave = WaveformHelper::envelope_adsr(harmonic2_wave, sub_adsr_2);
-          wave_comp.emplace_back(0.02f, harmonic2_wave);
+          WaveformHelper::apply_envelope_adsr(harmonic2_wave, sub_adsr_2);
+          wave_comp.emplace_back(0.02f, std::move(harmonic2_wave));
           
           // Generate a short burst of noise to simulate the initial "attack" of the kick drum
           float freq_mult_0 = 50.f; // 60;
@@ -242,9 +268,9 @@ namespace beat
           params.noise_filter_order = 2;
           params.noise_filter_rel_bw = 0.7f;
           auto noise = wave_gen.generate_waveform(WaveformType::NOISE, duration_s, freq_mult_0 * frequency_Hz);
-          noise = WaveformHelper::filter(noise, FilterType::ChebyshevTypeI, FilterOpType::LowPass, 1, freq_mult_1 * frequency_Hz, std::nullopt, 0.1f);
-          noise = WaveformHelper::envelope_adsr(noise, sub_adsr_3);
-          wave_comp.emplace_back(0.9f, noise);
+          WaveformHelper::apply_filter(noise, FilterType::ChebyshevTypeI, FilterOpType::LowPass, 1, freq_mult_1 * frequency_Hz, std::nullopt, 0.1f);
+          WaveformHelper::apply_envelope_adsr(noise, sub_adsr_3);
+          wave_comp.emplace_back(0.9f, std::move(noise));
           
           final_boost = true;
           final_normalize = true;
@@ -254,7 +280,7 @@ namespace beat
           adsr = adsr_presets::SNAREDRUM;
           noise = wave_gen.generate_waveform(WaveformType::NOISE,
             duration_s, std::nullopt);
-          wave_comp.emplace_back(0.7f, noise);
+          wave_comp.emplace_back(0.7f, std::move(noise));
           sawtooth = wave_gen.generate_waveform(WaveformType::SAWTOOTH, duration_s, frequency_Hz);
           square = wave_gen.generate_waveform(WaveformType::SQUARE, duration_s, frequency_Hz*1.1f,
             params, sample_rate, verbosity,
@@ -272,7 +298,7 @@ namespace beat
         case InstrumentType::ANVIL:
           adsr = adsr_presets::SNAREDRUM;
           noise = wave_gen.generate_waveform(WaveformType::NOISE, duration_s, std::nullopt);
-          wave_comp.emplace_back(0.6f, noise);
+          wave_comp.emplace_back(0.6f, std::move(noise));
           wave_comp.emplace_back(0.15f, wave_gen.generate_waveform(WaveformType::SINE, duration_s, 3.11f*frequency_Hz));
           wave_comp.emplace_back(0.25f, wave_gen.generate_waveform(WaveformType::TRIANGLE, duration_s, 5.43f*frequency_Hz));
           break;
@@ -9,8 +9,15 @@
 
 #include "Waveform.h"
 #include "WaveformHelper.h"
+#include "PRNG.h"
+#include "FastMath.h"
+#include "Wavetable.h"
+#include <array>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <optional>
+#include <span>
 #include <variant>
 #include <vector>
 
@@ -23,6 +30,15 @@
 // t, duration
 #define PHASE_FUNC_ARGS float, float
 
+// phi[], param[], out[]
+#define WAVEFORM_BLOCK_FUNC_ARGS std::span<const float>, std::span<const float>, std::span<float>
+// t[], duration, frequency_0, out[]
+#define FREQUENCY_BLOCK_FUNC_ARGS std::span<const float>, float, float, std::span<float>
+// t[], duration, out[]
+#define AMPLITUDE_BLOCK_FUNC_ARGS std::span<const float>, float, std::span<float>
+// t[], duration, out[]
+#define PHASE_BLOCK_FUNC_ARGS std::span<const float>, float, std::span<float>
+
 
 namespace beat
 {
@@ -66,25 +82,227 @@ namespace beat
     int noise_filter_order = 2;
     float noise_filter_rel_bw = 0.2f;
     float noise_filter_slot_dur_s = 1e-2f;
+    // Number of samples between each evaluation of the vibratos, the frequency slide and the duty cycle sweep.
+    // These are interpolated in between. control_rate = 1 evaluates them at every sample (exact).
+    int control_rate = 1;
+    // Seeds a PRNG owned by the generation call for NOISE and the JET_ENGINE_POWERUP functions.
+    // Renders with the same seed are bit-identical. If not set, the global rnd::rand() is used.
+    std::optional<uint64_t> seed = std::nullopt;
+    // PolyBLEP / PolyBLAMP correction of the discontinuities of SQUARE, TRIANGLE and SAWTOOTH.
+    // Reduces the aliasing on high notes. Follows duty_cycle and duty_cycle_sweep.
+    bool band_limited = false;
+    // FAST uses the polynomial approximations in FastMath for the SINE waveform,
+    // the vibratos and AmplitudeType::VIBRATO_0.
+    MathPolicy math_policy = MathPolicy::PRECISE;
+    // Wavetable oscillator mode. If set, the waveform is read from this table instead of
+    // being evaluated per sample. See WaveformGeneration::create_wavetable().
+    // The table replaces the waveform given to generate_waveform(). Only the duty cycle at the start
+    // is baked into the table, so duty_cycle_sweep has no effect. Not applicable to NOISE.
+    std::shared_ptr<const Wavetable> wavetable;
+    std::vector<ArpeggioPair> arpeggio;
+  };
+  
+  // WaveformGenerationParams with the optionals resolved and the arpeggio sorted into segments.
+  // Construct once and reuse it for all waveforms generated with the same params.
+  struct CompiledWaveformGenerationParams
+  {
+    struct Vibrato
+    {
+      bool enabled = false;
+      float depth = 0.f;
+      float freq = 0.f;
+      float freq_vel = 0.f;
+      float freq_acc = 0.f;
+      bool use_freq_acc_max_vel_limit = false;
+      float freq_acc_max_vel_limit = 0.f;
+      float phase = 0.f;
+    };
+    
+    explicit CompiledWaveformGenerationParams(const WaveformGenerationParams& params)
+    {
+      use_duty_cycle = params.duty_cycle.has_value();
+      duty_cycle = params.duty_cycle.value_or(0.f);
+      use_duty_cycle_sweep = params.duty_cycle_sweep.has_value();
+      duty_cycle_sweep = params.duty_cycle_sweep.value_or(0.f);
+      use_freq_slide = params.freq_slide_vel.has_value() || params.freq_slide_acc.has_value();
+      freq_slide_vel = params.freq_slide_vel.value_or(0.f);
+      freq_slide_acc = params.freq_slide_acc.value_or(0.f);
+      use_min_frequency_limit = params.min_frequency_limit.has_value();
+      min_frequency_limit = params.min_frequency_limit.value_or(0.f);
+      use_max_frequency_limit = params.max_frequency_limit.has_value();
+      max_frequency_limit = params.max_frequency_limit.value_or(0.f);
+      use_sample_range = params.sample_range_min.has_value() || params.sample_range_max.has_value();
+      sample_range_min = params.sample_range_min.value_or(-1.f);
+      sample_range_max = params.sample_range_max.value_or(+1.f);
+      freq_vibrato = compile_vibrato(params.freq_vibrato_depth,
+                                     params.freq_vibrato_freq,
+                                     params.freq_vibrato_freq_vel,
+                                     params.freq_vibrato_freq_acc,
+                                     params.freq_vibrato_freq_acc_max_vel_limit,
+                                     params.freq_vibrato_phase);
+      ampl_vibrato = compile_vibrato(params.vibrato_depth,
+                                     params.vibrato_freq,
+                                     params.vibrato_freq_vel,
+                                     params.vibrato_freq_acc,
+                                     params.vibrato_freq_acc_max_vel_limit,
+                                     params.vibrato_phase);
+      noise_filter_order = params.noise_filter_order;
+      noise_filter_rel_bw = params.noise_filter_rel_bw;
+      noise_filter_slot_dur_s = params.noise_filter_slot_dur_s;
+      control_rate = std::max(1, params.control_rate);
+      use_seed = params.seed.has_value();
+      seed = params.seed.value_or(0);
+      band_limited = params.band_limited;
+      math_policy = params.math_policy;
+      wavetable = params.wavetable;
+      
+      arpeggio = params.arpeggio;
+      stlutils::sort(arpeggio,
+        [](const auto& ap1, const auto& ap2) { return ap1.time < ap2.time; });
+      if (!arpeggio.empty() && arpeggio[0].time > 0.f)
+        arpeggio.insert(arpeggio.begin(), { 0.f, 1.f });
+    }
+    
+    bool use_duty_cycle = false;
+    float duty_cycle = 0.f;
+    bool use_duty_cycle_sweep = false;
+    float duty_cycle_sweep = 0.f;
+    bool use_freq_slide = false;
+    float freq_slide_vel = 0.f;
+    float freq_slide_acc = 0.f;
+    bool use_min_frequency_limit = false;
+    float min_frequency_limit = 0.f;
+    bool use_max_frequency_limit = false;
+    float max_frequency_limit = 0.f;
+    bool use_sample_range = false;
+    float sample_range_min = -1.f;
+    float sample_range_max = +1.f;
+    Vibrato freq_vibrato;
+    Vibrato ampl_vibrato;
+    int noise_filter_order = 2;
+    float noise_filter_rel_bw = 0.2f;
+    float noise_filter_slot_dur_s = 1e-2f;
+    int control_rate = 1;
+    bool use_seed = false;
+    uint64_t seed = 0;
+    bool band_limited = false;
+    MathPolicy math_policy = MathPolicy::PRECISE;
+    std::shared_ptr<const Wavetable> wavetable;
+    // Segment start times in ascending order, the first one at t = 0 s.
     std::vector<ArpeggioPair> arpeggio;
+    
+  private:
+    static Vibrato compile_vibrato(const std::optional<float>& vibrato_depth,
+                                   const std::optional<float>& vibrato_freq,
+                                   const std::optional<float>& vibrato_freq_vel,
+                                   const std::optional<float>& vibrato_freq_acc,
+                                   const std::optional<float>& vibrato_freq_acc_max_vel_limit,
+                                   const std::optional<float>& vibrato_phase)
+    {
+      Vibrato vib;
+      vib.enabled = vibrato_depth.has_value();
+      vib.depth = vibrato_depth.value_or(0.f);
+      vib.freq = vibrato_freq.value_or(0.f);
+      vib.freq_vel = vibrato_freq_vel.value_or(0.f);
+      vib.freq_acc = vibrato_freq_acc.value_or(0.f);
+      vib.use_freq_acc_max_vel_limit = vibrato_freq_acc_max_vel_limit.has_value();
+      vib.freq_acc_max_vel_limit = vibrato_freq_acc_max_vel_limit.value_or(0.f);
+      vib.phase = vibrato_phase.value_or(0.f);
+      return vib;
+    }
   };
   
+  // Band-pass filter for the NOISE waveform. A cascade of state-variable filter sections
+  // (trapezoidal integration) whose state carries over when the center frequency changes.
+  class NoiseBandPassFilter
+  {
+  public:
+    NoiseBandPassFilter(int num_sections = 1)
+      : m_state(std::max(1, num_sections), { 0.f, 0.f })
+    {}
+    
+    // rel_bw: bandwidth relative to freq_center_hz, i.e. 1/Q.
+    void set_center_frequency(float freq_center_hz, float rel_bw, int sample_rate)
+    {
+      auto fc = math::clamp(freq_center_hz, 1e-3f, 0.49f*sample_rate);
+      float g = std::tan(math::c_pi * fc / sample_rate);
+      m_k = std::max(rel_bw, 1e-3f);
+      m_a1 = 1.f/(1.f + g*(g + m_k));
+      m_a2 = g*m_a1;
+      m_a3 = g*m_a2;
+    }
+    
+    float process(float x)
+    {
+      for (auto& [ic1, ic2] : m_state)
+      {
+        float v3 = x - ic2;
+        float v1 = m_a1*ic1 + m_a2*v3;
+        float v2 = ic2 + m_a2*ic1 + m_a3*v3;
+        ic1 = 2.f*v1 - ic1;
+        ic2 = 2.f*v2 - ic2;
+        x = m_k*v1; // Unity gain at the center frequency.
+      }
+      return x;
+    }
+    
+    void reset()
+    {
+      for (auto& st : m_state)
+        st = { 0.f, 0.f };
+    }
+    
+  private:
+    std::vector<std::array<float, 2>> m_state;
+    float m_k = 1.f;
+    float m_a1 = 1.f;
+    float m_a2 = 0.f;
+    float m_a3 = 0.f;
+  };
+  
+  class Oscillator;
+  
   class WaveformGeneration
   {
+    friend class Oscillator;
+    
   public:
     using WaveformFunc = std::function<float(WAVEFORM_FUNC_ARGS)>;
     using FrequencyFunc = std::function<float(FREQUENCY_FUNC_ARGS)>;
     using AmplitudeFunc = std::function<float(AMPLITUDE_FUNC_ARGS)>;
     using PhaseFunc = std::function<float(PHASE_FUNC_ARGS)>;
-    using WaveformFuncArg = std::variant<WaveformType, WaveformFunc>;
-    using FrequencyFuncArg = std::variant<FrequencyType, FrequencyFunc>;
-    using AmplitudeFuncArg = std::variant<AmplitudeType, AmplitudeFunc>;
-    using PhaseFuncArg = std::variant<PhaseType, PhaseFunc>;
+    // Block callbacks are called with up to c_block_size samples at a time.
+    using WaveformBlockFunc = std::function<void(WAVEFORM_BLOCK_FUNC_ARGS)>;
+    using FrequencyBlockFunc = std::function<void(FREQUENCY_BLOCK_FUNC_ARGS)>;
+    using AmplitudeBlockFunc = std::function<void(AMPLITUDE_BLOCK_FUNC_ARGS)>;
+    using PhaseBlockFunc = std::function<void(PHASE_BLOCK_FUNC_ARGS)>;
+    using WaveformFuncArg = std::variant<WaveformType, WaveformFunc, WaveformBlockFunc>;
+    using FrequencyFuncArg = std::variant<FrequencyType, FrequencyFunc, FrequencyBlockFunc>;
+    using AmplitudeFuncArg = std::variant<AmplitudeType, AmplitudeFunc, AmplitudeBlockFunc>;
+    using PhaseFuncArg = std::variant<PhaseType, PhaseFunc, PhaseBlockFunc>;
+    
+    static constexpr int c_block_size = 256;
     
     // Function to generate a simple waveform buffer
     Waveform generate_waveform(const WaveformFuncArg& wave_func_arg = WaveformType::SINE,
                                float duration = 10.f, std::optional<float> frequency = 440.f,
-                               WaveformGenerationParams params = {},
+                               const WaveformGenerationParams& params = {},
+                               int sample_rate = 44100,
+                               bool verbose = false,
+                               const FrequencyFuncArg& freq_func_arg = FrequencyType::CONSTANT,
+                               const AmplitudeFuncArg& ampl_func_arg = AmplitudeType::CONSTANT,
+                               const PhaseFuncArg& phase_func_arg = PhaseType::ZERO) const
+    {
+      return generate_waveform(wave_func_arg, duration, frequency,
+                               CompiledWaveformGenerationParams(params),
+                               sample_rate, verbose,
+                               freq_func_arg, ampl_func_arg, phase_func_arg);
+    }
+    
+    // Same as above but with params compiled beforehand.
+    Waveform generate_waveform(const WaveformFuncArg& wave_func_arg,
+                               float duration, std::optional<float> frequency,
+                               const CompiledWaveformGenerationParams& params,
                                int sample_rate = 44100,
                                bool verbose = false,
                                const FrequencyFuncArg& freq_func_arg = FrequencyType::CONSTANT,
@@ -98,151 +316,583 @@ namespace beat
       wd.duration = duration;
       
       auto buffer_len = static_cast<int>(duration * sample_rate);
-      float ampl_mod = 1.f;
       
       wd.buffer.resize(buffer_len);
       
-      // Argument Functions
-      auto [wave_func, wave_enum] = extract_waveform_func(wave_func_arg, verbose);
-      auto freq_func = extract_frequency_func(freq_func_arg, verbose);
-      auto ampl_func = extract_amplitude_func(ampl_func_arg, verbose);
-      auto phase_func = extract_phase_func(phase_func_arg, verbose);
+      const RenderSetup setup { freq_val, frequency.has_value(), duration, sample_rate };
+      
+      bool is_noise = false;
+      if (std::holds_alternative<WaveformType>(wave_func_arg)
+          && std::holds_alternative<FrequencyType>(freq_func_arg)
+          && std::holds_alternative<AmplitudeType>(ampl_func_arg)
+          && std::holds_alternative<PhaseType>(phase_func_arg))
+      {
+        if (verbose)
+        {
+          extract_waveform_func(wave_func_arg, verbose);
+          extract_frequency_func(freq_func_arg, verbose);
+          extract_amplitude_func(ampl_func_arg, verbose);
+          extract_phase_func(phase_func_arg, verbose);
+        }
+        auto wave_type = std::get<WaveformType>(wave_func_arg);
+        is_noise = wave_type == WaveformType::NOISE;
+        // Only built-in types: use a kernel specialized at compile-time for this combination.
+        auto render_kernel = select_render_kernel(wave_type,
+                                                  std::get<FrequencyType>(freq_func_arg),
+                                                  std::get<AmplitudeType>(ampl_func_arg));
+        RenderState state(params, setup, wave_type);
+        render_kernel(wd.buffer, params, setup, state);
+      }
+      else
+      {
+        auto funcs = extract_render_funcs(wave_func_arg, freq_func_arg, ampl_func_arg, phase_func_arg, verbose);
+        is_noise = funcs.wave_type == WaveformType::NOISE;
+        RenderState state(params, setup, funcs.wave_type);
+        render_generic(wd.buffer, params, setup, state, funcs);
+      }
       
-      double accumulated_frequency = 0.0;
+      if (is_noise && frequency.has_value())
+        WaveformHelper::normalize(wd);
       
-      float duty_cycle_0 = 0.f;
-      bool is_square = (wave_enum == static_cast<int>(WaveformType::SQUARE));
-      bool is_triangle = (wave_enum == static_cast<int>(WaveformType::TRIANGLE));
-      bool is_sawtooth = (wave_enum == static_cast<int>(WaveformType::SAWTOOTH));
-      bool is_noise = (wave_enum == static_cast<int>(WaveformType::NOISE));
-      if (is_square || is_triangle || is_sawtooth)
+      return wd;
+    }
+    
+    // Samples one cycle of the waveform into a band-limited, mip-mapped Wavetable.
+    // Built-in waveforms are sampled with the duty cycle of params.
+    // Use it via WaveformGenerationParams::wavetable. Returns nullptr for NOISE.
+    std::shared_ptr<const Wavetable> create_wavetable(const WaveformFuncArg& wave_func_arg,
+                                                      const WaveformGenerationParams& params = {}) const
+    {
+      auto [wave_func, wave_enum] = extract_waveform_func(wave_func_arg, false);
+      if (wave_enum == static_cast<int>(WaveformType::NOISE))
       {
-        if (params.duty_cycle.has_value())
-          duty_cycle_0 = params.duty_cycle.value();
-        else if (is_sawtooth)
-          duty_cycle_0 = 1.f;
-        else if (is_square || is_triangle)
-          duty_cycle_0 = 0.5f;
+        std::cerr << "ERROR in create_wavetable() : NOISE can't be sampled into a wavetable!" << std::endl;
+        return nullptr;
       }
-      float duty_cycle = duty_cycle_0;
       
-      float t = 0.f;
-      stlutils::sort(params.arpeggio,
-        [](const auto& ap1, const auto& ap2) { return ap1.time < ap2.time; });
-      if (!params.arpeggio.empty() && params.arpeggio[0].time > 0.f)
-        params.arpeggio.insert(params.arpeggio.begin(), { 0.f, 1.f });
-      int Narp = static_cast<int>(params.arpeggio.size());
-            
-      const int N = static_cast<int>(params.noise_filter_slot_dur_s * sample_rate);
-      std::vector<float> noise_buffer(N, 0.f);
+      // Same duty cycle as the first sample of generate_waveform().
+      const auto dc_eps = 1e-10f;
+      auto wave_type = wave_enum >= 0 ? static_cast<WaveformType>(wave_enum) : WaveformType::SINE;
+      auto duty_cycle = math::clamp(calc_duty_cycle_0(CompiledParams(params), wave_type), dc_eps, 1.f - dc_eps);
+      
+      std::vector<float> phi(Wavetable::c_table_size);
+      std::vector<float> param(Wavetable::c_table_size, duty_cycle);
+      std::vector<float> cycle(Wavetable::c_table_size);
+      for (int i = 0; i < Wavetable::c_table_size; ++i)
+        phi[i] = math::c_2pi * static_cast<float>(i) / Wavetable::c_table_size;
+      wave_func(phi, param, cycle);
+      
+      return std::make_shared<const Wavetable>(cycle);
+    }
+    
+  private:
+    using CompiledParams = CompiledWaveformGenerationParams;
+    
+    // Separate streams for the waveform, frequency and amplitude functions
+    // so that the noise can be drawn in bulk.
+    struct RandomStreams
+    {
+      explicit RandomStreams(uint64_t seed)
+        : wave(seed), freq(seed + 1), ampl(seed + 2)
+      {}
+      PRNG wave;
+      PRNG freq;
+      PRNG ampl;
+    };
+    
+    static float calc_duty_cycle_0(const CompiledParams& cp, WaveformType wave_type)
+    {
+      if (wave_type == WaveformType::SQUARE || wave_type == WaveformType::TRIANGLE)
+        return cp.use_duty_cycle ? cp.duty_cycle : 0.5f;
+      else if (wave_type == WaveformType::SAWTOOTH)
+        return cp.use_duty_cycle ? cp.duty_cycle : 1.f;
+      return 0.f;
+    }
+    
+    // Walks the arpeggio segments for monotonically increasing t.
+    class ArpeggioCursor
+    {
+    public:
+      void apply(const std::vector<ArpeggioPair>& arpeggio, float& freq_mod, float t)
+      {
+        while (m_idx + 1 < static_cast<int>(arpeggio.size()) && arpeggio[m_idx + 1].time <= t)
+          m_idx++;
+        if (m_idx >= 0)
+          freq_mod *= arpeggio[m_idx].freq_mult;
+      }
+      
+    private:
+      int m_idx = -1;
+    };
+    
+    static inline float calc_vibrato(float t, const CompiledParams::Vibrato& kv, MathPolicy math_policy)
+    {
+      float vib_freq_acc_term = 0.5f*kv.freq_acc*t;
+      if (kv.use_freq_acc_max_vel_limit)
+        math::minimize(vib_freq_acc_term, kv.freq_acc_max_vel_limit);
+      float vib_freq = std::max(0.f, kv.freq + (kv.freq_vel + vib_freq_acc_term)*t);
+      return (1.f - kv.depth) + kv.depth*FastMath::sin(math::c_2pi*vib_freq*t + kv.phase, math_policy);
+    }
+    
+    // Octaves of the frequency slide at time t.
+    static inline float calc_freq_slide_exponent(float t, const CompiledParams& kp)
+    {
+      return (kp.freq_slide_vel + 0.5f*kp.freq_slide_acc * t) * t;
+    }
+    
+    // Slow modulators evaluated every control_rate samples.
+    // Vibratos and duty cycle are interpolated linearly in between and
+    // the frequency slide exponentially via a multiplicative recurrence.
+    struct ControlRateState
+    {
+      float freq_vibrato = 1.f;
+      float freq_vibrato_step = 0.f;
+      float freq_slide = 1.f;
+      float freq_slide_ratio = 1.f;
+      float ampl_vibrato = 1.f;
+      float ampl_vibrato_step = 0.f;
+      float duty_cycle = 0.f;
+      float duty_cycle_step = 0.f;
       
-      auto f_calc_vibrato = [](float& mod, float t,
-                               const std::optional<float>& vibrato_depth,
-                               const std::optional<float>& vibrato_freq,
-                               const std::optional<float>& vibrato_freq_vel,
-                               const std::optional<float>& vibrato_freq_acc,
-                               const std::optional<float>& vibrato_freq_acc_max_vel_limit,
-                               const std::optional<float>& vibrato_phase)
+      // Sets up the interpolation from sample i to sample i + control_rate.
+      void start_segment(const CompiledParams& kp, float duty_cycle_0, int64_t i, int control_rate, int sample_rate)
       {
-        if (vibrato_depth.has_value())
+        float t0 = static_cast<float>(static_cast<double>(i) / sample_rate);
+        float t1 = static_cast<float>(static_cast<double>(i + control_rate) / sample_rate);
+        float inv_cr = 1.f / control_rate;
+        if (kp.freq_vibrato.enabled)
         {
-          float vib_freq = vibrato_freq.value_or(0.f);
-          float vib_depth = vibrato_depth.value_or(0.f);
-          float vib_freq_vel = vibrato_freq_vel.value_or(0.f);
-          float vib_freq_acc = vibrato_freq_acc.value_or(0.f);
-          float vib_freq_acc_term = 0.5f*vib_freq_acc*t;
-          float vib_phase = vibrato_phase.value_or(0.f);
-          if (vibrato_freq_acc_max_vel_limit.has_value())
-            math::minimize(vib_freq_acc_term, vibrato_freq_acc_max_vel_limit.value());
-          vib_freq = std::max(0.f, vib_freq + (vib_freq_vel + vib_freq_acc_term)*t);
-          float vibrato = (1.f - vib_depth) + vib_depth*std::sin(math::c_2pi*vib_freq*t + vib_phase);
-          mod *= vibrato;
+          freq_vibrato = calc_vibrato(t0, kp.freq_vibrato, kp.math_policy);
+          freq_vibrato_step = (calc_vibrato(t1, kp.freq_vibrato, kp.math_policy) - freq_vibrato) * inv_cr;
         }
-      };
+        if (kp.use_freq_slide)
+        {
+          float e0 = calc_freq_slide_exponent(t0, kp);
+          float e1 = calc_freq_slide_exponent(t1, kp);
+          freq_slide = std::exp2(e0);
+          freq_slide_ratio = std::exp2((e1 - e0) * inv_cr);
+        }
+        if (kp.ampl_vibrato.enabled)
+        {
+          ampl_vibrato = calc_vibrato(t0, kp.ampl_vibrato, kp.math_policy);
+          ampl_vibrato_step = (calc_vibrato(t1, kp.ampl_vibrato, kp.math_policy) - ampl_vibrato) * inv_cr;
+        }
+        duty_cycle = duty_cycle_0 + t0 * kp.duty_cycle_sweep;
+        duty_cycle_step = kp.duty_cycle_sweep / sample_rate;
+      }
       
-      for (int i = 0; i < buffer_len; ++i)
+      void advance()
       {
-        t = static_cast<float>(i) / sample_rate;
-        
-        // Frequency
-        float freq_mod = freq_func(t, duration, freq_val);
-        f_calc_vibrato(freq_mod, t,
-                       params.freq_vibrato_depth,
-                       params.freq_vibrato_freq,
-                       params.freq_vibrato_freq_vel,
-                       params.freq_vibrato_freq_acc,
-                       params.freq_vibrato_freq_acc_max_vel_limit,
-                       params.freq_vibrato_phase);
-        freq_mod *= static_cast<float>(std::pow(2.0, (params.freq_slide_vel.value_or(0.f) + 0.5f*params.freq_slide_acc.value_or(0.f) * t) * t));
-        if (!params.arpeggio.empty())
+        freq_vibrato += freq_vibrato_step;
+        freq_slide *= freq_slide_ratio;
+        ampl_vibrato += ampl_vibrato_step;
+        duty_cycle += duty_cycle_step;
+      }
+    };
+    
+    // Applies vibratos, frequency slide, arpeggio, frequency limits and duty cycle sweep to one sample.
+    // Evaluates the slow modulators exactly if crs is nullptr, otherwise takes them from crs.
+    static inline void apply_modulators(float& freq_mod, float& ampl_mod, float& duty_cycle, float t,
+                                        const CompiledParams& kp, float duty_cycle_0,
+                                        ArpeggioCursor& arpeggio,
+                                        const ControlRateState* crs)
+    {
+      // Frequency
+      if (kp.freq_vibrato.enabled)
+        freq_mod *= crs != nullptr ? crs->freq_vibrato : calc_vibrato(t, kp.freq_vibrato, kp.math_policy);
+      if (kp.use_freq_slide)
+        freq_mod *= crs != nullptr ? crs->freq_slide : static_cast<float>(std::pow(2.0, calc_freq_slide_exponent(t, kp)));
+      arpeggio.apply(kp.arpeggio, freq_mod, t);
+      // Ensure frequency doesn't go below min_frequency_cutoff or above max_frequency_cutoff.
+      // min_frequency_limit <= freq_mod <= max_frequency_limit.
+      if (kp.use_min_frequency_limit)
+        math::maximize(freq_mod, kp.min_frequency_limit);
+      if (kp.use_max_frequency_limit)
+        math::minimize(freq_mod, kp.max_frequency_limit);
+      
+      // Amplitude
+      if (kp.ampl_vibrato.enabled)
+        ampl_mod *= crs != nullptr ? crs->ampl_vibrato : calc_vibrato(t, kp.ampl_vibrato, kp.math_policy);
+      
+      // Duty Cycle
+      if (kp.use_duty_cycle_sweep)
+      {
+        const auto dc_eps = 1e-10f;
+        duty_cycle = math::clamp(crs != nullptr ? crs->duty_cycle : duty_cycle_0 + t * kp.duty_cycle_sweep,
+                                 dc_eps, 1.f - dc_eps);
+      }
+    }
+    
+    // Calls func with std::integral_constant<Enum, E> for the E in Es that matches val.
+    template <typename Enum, Enum... Es, typename Lambda>
+    static void dispatch_enum(Enum val, Lambda&& func)
+    {
+      ((val == Es ? (func(std::integral_constant<Enum, Es> {}), true) : false) || ...);
+    }
+    
+    // Number of samples between each update of the noise filter center frequency.
+    static int calc_noise_filter_slot_len(const CompiledParams& kp, int sample_rate)
+    {
+      return std::max(1, static_cast<int>(kp.noise_filter_slot_dur_s * sample_rate));
+    }
+    
+    // Band-pass filters the noise around the current frequency.
+    static inline float filter_noise_sample(NoiseBandPassFilter& noise_flt, int64_t i, int slot_len,
+                                            float sample, float freq_mod, const CompiledParams& kp,
+                                            int sample_rate)
+    {
+      if (i % slot_len == 0)
+        noise_flt.set_center_frequency(freq_mod, kp.noise_filter_rel_bw, sample_rate);
+      return noise_flt.process(sample);
+    }
+    
+    // Keeps the accumulated frequency within [0, sample_rate), i.e. the phase within [0, 2*pi),
+    // so that the phase stays accurate for arbitrarily long tones.
+    static inline void wrap_accumulated_frequency(double& accumulated_frequency, int sample_rate)
+    {
+      if (accumulated_frequency >= sample_rate || accumulated_frequency < 0.)
+        accumulated_frequency -= sample_rate * std::floor(accumulated_frequency / sample_rate);
+    }
+    
+    struct RenderSetup
+    {
+      float frequency = 440.f;
+      bool has_frequency = true;
+      float duration = 10.f;
+      int sample_rate = 44100;
+    };
+    
+    // State carried between calls when rendering a waveform in chunks.
+    struct RenderState
+    {
+      // wave_type: std::nullopt for custom waveforms (no duty cycle).
+      RenderState(const CompiledParams& kp, const RenderSetup& setup, std::optional<WaveformType> wave_type)
+        : duty_cycle_0(calc_duty_cycle_0(kp, wave_type.value_or(WaveformType::SINE)))
+        , filter_noise(wave_type == WaveformType::NOISE && setup.has_frequency)
+        , noise_slot_len(calc_noise_filter_slot_len(kp, setup.sample_rate))
+        , noise_flt(filter_noise ? kp.noise_filter_order : 0)
+      {
+        const auto dc_eps = 1e-10f;
+        duty_cycle = math::clamp(duty_cycle_0, dc_eps, 1.f - dc_eps);
+        if (kp.use_seed)
+          rs.emplace(kp.seed);
+      }
+      
+      int64_t i = 0; // Index of the next sample.
+      double accumulated_frequency = 0.0; // Wrapped to [0, sample_rate).
+      uint32_t wavetable_phase = 0; // Fixed-point phase for the wavetable mode.
+      float duty_cycle_0 = 0.f;
+      float duty_cycle = 0.f;
+      ControlRateState crs;
+      ArpeggioCursor arpeggio;
+      bool filter_noise = false;
+      int noise_slot_len = 1;
+      NoiseBandPassFilter noise_flt;
+      std::optional<RandomStreams> rs;
+    };
+    
+    using RenderKernel = void (*)(std::span<float>, const CompiledParams&, const RenderSetup&, RenderState&);
+    
+    // Specialized kernel for the built-in waveform, frequency and amplitude types.
+    // The built-in phase function is always PhaseType::ZERO.
+    template <WaveformType WT, FrequencyType FT, AmplitudeType AT>
+    static void render_kernel(std::span<float> out, const CompiledParams& kp,
+                              const RenderSetup& setup, RenderState& st)
+    {
+      const int sample_rate = setup.sample_rate;
+      const float duration = setup.duration;
+      const float freq_val = setup.frequency;
+      const auto num_samples = static_cast<int>(out.size());
+      const bool filter_noise = WT == WaveformType::NOISE && st.filter_noise;
+      const float duty_cycle_0 = st.duty_cycle_0;
+      
+      const int control_rate = kp.control_rate;
+      ControlRateState* crs_ptr = control_rate > 1 ? &st.crs : nullptr;
+      RandomStreams* rs_ptr = st.rs.has_value() ? &st.rs.value() : nullptr;
+      const Wavetable* wavetable = WT != WaveformType::NOISE ? kp.wavetable.get() : nullptr;
+      const bool band_limited = kp.band_limited && has_band_limited_waveform(WT);
+      // SINE with MathPolicy::FAST is evaluated a block at a time with the SIMD FastMath::sin().
+      const bool fast_sine = WT == WaveformType::SINE && kp.math_policy == MathPolicy::FAST && wavetable == nullptr;
+      std::array<float, c_block_size> phase_block;
+      std::array<float, c_block_size> ampl_block;
+      
+      float duty_cycle = st.duty_cycle;
+      double accumulated_frequency = st.accumulated_frequency;
+      uint32_t wavetable_phase = st.wavetable_phase;
+      
+      for (int k0 = 0; k0 < num_samples; k0 += c_block_size)
+      {
+        const int n = std::min(c_block_size, num_samples - k0);
+        for (int k = k0; k < k0 + n; ++k)
         {
-          for (int a_idx = 0; a_idx < Narp - 1; ++a_idx)
-            if (math::in_range(t, params.arpeggio[a_idx].time, params.arpeggio[a_idx + 1].time, Range::ClosedOpen))
-              freq_mod *= params.arpeggio[a_idx].freq_mult;
-          if (math::in_range(t, params.arpeggio.back().time, {}, Range::ClosedFree))
-            freq_mod *= params.arpeggio.back().freq_mult;
+          const int64_t i = st.i + k;
+          float t = static_cast<float>(static_cast<double>(i) / sample_rate);
+          
+          if (crs_ptr != nullptr)
+          {
+            if (i % control_rate == 0)
+              crs_ptr->start_segment(kp, duty_cycle_0, i, control_rate, sample_rate);
+            else
+              crs_ptr->advance();
+          }
+          
+          float freq_mod = calc_frequency<FT>(t, duration, freq_val, rs_ptr);
+          float ampl_mod = calc_amplitude<AT>(t, duration, rs_ptr, kp.math_policy);
+          apply_modulators(freq_mod, ampl_mod, duty_cycle, t, kp, duty_cycle_0, st.arpeggio, crs_ptr);
+          
+          accumulated_frequency += freq_mod;
+          wrap_accumulated_frequency(accumulated_frequency, sample_rate);
+          
+          float sample = 0.f;
+          if (wavetable != nullptr)
+          {
+            wavetable_phase += Wavetable::phase_increment(freq_mod, sample_rate);
+            sample = ampl_mod * wavetable->lookup(wavetable_phase, Wavetable::select_level(freq_mod, sample_rate));
+          }
+          else
+          {
+            constexpr float phi = 0.f; // PhaseType::ZERO.
+            auto phase_modulation = static_cast<float>(math::c_2pi * accumulated_frequency / sample_rate + phi);
+            if (fast_sine)
+            {
+              phase_block[k - k0] = phase_modulation;
+              ampl_block[k - k0] = ampl_mod;
+              continue;
+            }
+            else if (band_limited)
+              sample = ampl_mod * calc_waveform_band_limited<WT>(phase_modulation, duty_cycle, freq_mod / sample_rate);
+            else
+              sample = ampl_mod * calc_waveform<WT>(phase_modulation, duty_cycle, rs_ptr);
+          }
+          if (kp.use_sample_range)
+            sample = math::linmap(sample, -1.f, +1.f, kp.sample_range_min, kp.sample_range_max);
+          if (filter_noise)
+            sample = filter_noise_sample(st.noise_flt, i, st.noise_slot_len, sample, freq_mod, kp, sample_rate);
+          out[k] = sample;
         }
-        // Ensure frequency doesn't go below min_frequency_cutoff or above max_frequency_cutoff.
-        // min_frequency_limit <= freq_mod <= max_frequency_limit.
-        if (params.min_frequency_limit.has_value())
-          math::maximize(freq_mod, params.min_frequency_limit.value());
-        if (params.max_frequency_limit.has_value())
-          math::minimize(freq_mod, params.max_frequency_limit.value());
-        
-        // Amplitude
-        ampl_mod = ampl_func(t, duration);
-        f_calc_vibrato(ampl_mod, t,
-                       params.vibrato_depth,
-                       params.vibrato_freq,
-                       params.vibrato_freq_vel,
-                       params.vibrato_freq_acc,
-                       params.vibrato_freq_acc_max_vel_limit,
-                       params.vibrato_phase);
         
-        // Duty Cycle
-        if (params.duty_cycle_sweep.has_value())
-          duty_cycle = duty_cycle_0 + t * params.duty_cycle_sweep.value();
-        const auto dc_eps = 1e-10f;
-        duty_cycle = math::clamp(duty_cycle, dc_eps, 1.f - dc_eps);
+        if (fast_sine)
+        {
+          std::span<float> out_block = out.subspan(k0, n);
+          FastMath::sin(std::span<const float>(phase_block.data(), n), out_block);
+          for (int k = 0; k < n; ++k)
+          {
+            float sample = ampl_block[k] * out_block[k];
+            if (kp.use_sample_range)
+              sample = math::linmap(sample, -1.f, +1.f, kp.sample_range_min, kp.sample_range_max);
+            out_block[k] = sample;
+          }
+        }
+      }
+      
+      st.i += num_samples;
+      st.duty_cycle = duty_cycle;
+      st.accumulated_frequency = accumulated_frequency;
+      st.wavetable_phase = wavetable_phase;
+    }
+    
+    static RenderKernel select_render_kernel(WaveformType wave_type, FrequencyType freq_type, AmplitudeType ampl_type)
+    {
+      RenderKernel kernel = nullptr;
+      dispatch_enum<WaveformType, WaveformType::SINE, WaveformType::SQUARE, WaveformType::TRIANGLE,
+                    WaveformType::SAWTOOTH, WaveformType::NOISE>(wave_type, [&](auto wt)
+      {
+        dispatch_enum<FrequencyType, FrequencyType::CONSTANT, FrequencyType::JET_ENGINE_POWERUP,
+                      FrequencyType::CHIRP_0, FrequencyType::CHIRP_1, FrequencyType::CHIRP_2>(freq_type, [&](auto ft)
+        {
+          dispatch_enum<AmplitudeType, AmplitudeType::CONSTANT, AmplitudeType::JET_ENGINE_POWERUP,
+                        AmplitudeType::VIBRATO_0>(ampl_type, [&](auto at)
+          {
+            kernel = &render_kernel<decltype(wt)::value, decltype(ft)::value, decltype(at)::value>;
+          });
+        });
+      });
+      return kernel;
+    }
+    
+    // Block functions used by the generic path.
+    struct RenderFuncs
+    {
+      WaveformBlockFunc wave;
+      FrequencyBlockFunc freq;
+      AmplitudeBlockFunc ampl;
+      PhaseBlockFunc phase;
+      std::optional<WaveformType> wave_type; // std::nullopt for custom waveforms.
+      // Built-in random functions are drawn from the seeded streams if any.
+      bool is_freq_jet_engine_powerup = false;
+      bool is_ampl_jet_engine_powerup = false;
+    };
+    
+    static RenderFuncs extract_render_funcs(const WaveformFuncArg& wave_func_arg,
+                                            const FrequencyFuncArg& freq_func_arg,
+                                            const AmplitudeFuncArg& ampl_func_arg,
+                                            const PhaseFuncArg& phase_func_arg,
+                                            bool verbose)
+    {
+      RenderFuncs funcs;
+      auto [wave_func, wave_enum] = extract_waveform_func(wave_func_arg, verbose);
+      funcs.wave = wave_func;
+      if (wave_enum >= 0)
+        funcs.wave_type = static_cast<WaveformType>(wave_enum);
+      funcs.freq = extract_frequency_func(freq_func_arg, verbose);
+      funcs.ampl = extract_amplitude_func(ampl_func_arg, verbose);
+      funcs.phase = extract_phase_func(phase_func_arg, verbose);
+      funcs.is_freq_jet_engine_powerup = std::holds_alternative<FrequencyType>(freq_func_arg)
+        && std::get<FrequencyType>(freq_func_arg) == FrequencyType::JET_ENGINE_POWERUP;
+      funcs.is_ampl_jet_engine_powerup = std::holds_alternative<AmplitudeType>(ampl_func_arg)
+        && std::get<AmplitudeType>(ampl_func_arg) == AmplitudeType::JET_ENGINE_POWERUP;
+      return funcs;
+    }
+    
+    // Generic path for custom waveform, frequency, amplitude and phase functions.
+    // Processes the waveform in blocks of c_block_size samples.
+    // Per-sample callbacks are wrapped into block callbacks.
+    static void render_generic(std::span<float> out, const CompiledParams& kp,
+                               const RenderSetup& setup, RenderState& st,
+                               const RenderFuncs& funcs)
+    {
+      const int sample_rate = setup.sample_rate;
+      const float duration = setup.duration;
+      const float freq_val = setup.frequency;
+      const auto num_samples = static_cast<int>(out.size());
+      const float duty_cycle_0 = st.duty_cycle_0;
+      
+      const int control_rate = kp.control_rate;
+      ControlRateState* crs_ptr = control_rate > 1 ? &st.crs : nullptr;
+      RandomStreams* rs_ptr = st.rs.has_value() ? &st.rs.value() : nullptr;
+      const Wavetable* wavetable = funcs.wave_type != WaveformType::NOISE ? kp.wavetable.get() : nullptr;
+      const bool band_limited = kp.band_limited && funcs.wave_type.has_value()
+        && has_band_limited_waveform(funcs.wave_type.value());
+      const bool fast_sine = funcs.wave_type == WaveformType::SINE && kp.math_policy == MathPolicy::FAST;
+      
+      std::array<float, c_block_size> t_block;
+      std::array<float, c_block_size> freq_block;
+      std::array<float, c_block_size> ampl_block;
+      std::array<float, c_block_size> phi_block;
+      std::array<float, c_block_size> param_block;
+      std::array<float, c_block_size> wave_block;
+      
+      for (int k0 = 0; k0 < num_samples; k0 += c_block_size)
+      {
+        const int64_t i0 = st.i + k0;
+        const int n = std::min(c_block_size, num_samples - k0);
+        for (int k = 0; k < n; ++k)
+          t_block[k] = static_cast<float>(static_cast<double>(i0 + k) / sample_rate);
+        std::span<const float> t_span(t_block.data(), n);
         
-        // Accumulate frequency for phase modulation
-        accumulated_frequency += freq_mod;
+        if (rs_ptr != nullptr && funcs.is_freq_jet_engine_powerup)
+          for (int k = 0; k < n; ++k)
+            freq_block[k] = calc_frequency<FrequencyType::JET_ENGINE_POWERUP>(t_block[k], duration, freq_val, rs_ptr);
+        else
+          funcs.freq(t_span, duration, freq_val, std::span<float>(freq_block.data(), n));
+        if (rs_ptr != nullptr && funcs.is_ampl_jet_engine_powerup)
+          for (int k = 0; k < n; ++k)
+            ampl_block[k] = calc_amplitude<AmplitudeType::JET_ENGINE_POWERUP>(t_block[k], duration, rs_ptr, kp.math_policy);
+        else
+          funcs.ampl(t_span, duration, std::span<float>(ampl_block.data(), n));
+        funcs.phase(t_span, duration, std::span<float>(phi_block.data(), n));
         
-        // Apply phase modulation similar to Octave code
-        float phi = phase_func(t, duration);
-        auto phase_modulation = static_cast<float>(math::c_2pi * accumulated_frequency / sample_rate + phi);
-        float sample = ampl_mod * wave_func(phase_modulation, duty_cycle);
-        if (params.sample_range_min.has_value() || params.sample_range_max.has_value())
-          sample = math::linmap(sample, -1.f, +1.f, params.sample_range_min.value_or(-1.f), params.sample_range_max.value_or(+1.f));
-        if (is_noise && frequency.has_value())
+        for (int k = 0; k < n; ++k)
         {
-          int imN = i % N;
-          noise_buffer[imN] = sample;
-          if (imN == N - 1)
+          if (crs_ptr != nullptr)
+          {
+            if ((i0 + k) % control_rate == 0)
+              crs_ptr->start_segment(kp, duty_cycle_0, i0 + k, control_rate, sample_rate);
+            else
+              crs_ptr->advance();
+          }
+          
+          float& freq_mod = freq_block[k];
+          apply_modulators(freq_mod, ampl_block[k], st.duty_cycle, t_block[k], kp, duty_cycle_0, st.arpeggio, crs_ptr);
+          param_block[k] = st.duty_cycle;
+          
+          // Accumulate frequency for phase modulation
+          st.accumulated_frequency += freq_mod;
+          wrap_accumulated_frequency(st.accumulated_frequency, sample_rate);
+          
+          if (wavetable != nullptr)
+          {
+            st.wavetable_phase += Wavetable::phase_increment(freq_mod, sample_rate);
+            wave_block[k] = wavetable->lookup(st.wavetable_phase + Wavetable::phase_offset(phi_block[k]),
+                                              Wavetable::select_level(freq_mod, sample_rate));
+          }
+          else
           {
-            Filter bp_flt = WaveformHelper::create_Butterworth_filter(params.noise_filter_order, FilterOpType::BandPass, freq_mod, params.noise_filter_rel_bw*freq_mod, sample_rate);
-            
-            noise_buffer = WaveformHelper::filter(noise_buffer, bp_flt);
-            for (int j = 0; j < N && i + j < buffer_len; ++j)
-              wd.buffer[i + j] = noise_buffer[j];
+            // Apply phase modulation similar to Octave code
+            phi_block[k] = static_cast<float>(math::c_2pi * st.accumulated_frequency / sample_rate + phi_block[k]);
           }
         }
-        else
-          wd.buffer[i] = sample; // Regular sample assign.
+        
+        std::span<float> wave_span(wave_block.data(), n);
+        if (wavetable == nullptr)
+        {
+          if (rs_ptr != nullptr && funcs.wave_type == WaveformType::NOISE)
+            rs_ptr->wave.fill(wave_span, -1.f, +1.f);
+          else if (fast_sine)
+            FastMath::sin(std::span<const float>(phi_block.data(), n), wave_span);
+          else if (band_limited)
+            dispatch_enum<WaveformType, WaveformType::SQUARE, WaveformType::TRIANGLE,
+                          WaveformType::SAWTOOTH>(funcs.wave_type.value(), [&](auto wt)
+            {
+              for (int k = 0; k < n; ++k)
+                wave_block[k] = calc_waveform_band_limited<decltype(wt)::value>(phi_block[k], param_block[k],
+                                                                                freq_block[k] / sample_rate);
+            });
+          else
+            funcs.wave(std::span<const float>(phi_block.data(), n),
+                       std::span<const float>(param_block.data(), n),
+                       wave_span);
+        }
+        
+        for (int k = 0; k < n; ++k)
+        {
+          float sample = ampl_block[k] * wave_block[k];
+          if (kp.use_sample_range)
+            sample = math::linmap(sample, -1.f, +1.f, kp.sample_range_min, kp.sample_range_max);
+          if (st.filter_noise)
+            sample = filter_noise_sample(st.noise_flt, i0 + k, st.noise_slot_len, sample, freq_block[k], kp, sample_rate);
+          out[k0 + k] = sample;
+        }
       }
       
-      if (is_noise && frequency.has_value())
-        WaveformHelper::normalize(wd);
-      
-      return wd;
+      st.i += num_samples;
     }
     
-  private:
-    std::pair<WaveformFunc, int> extract_waveform_func(const WaveformFuncArg& wave_func_arg, bool verbose) const
+    // Compatibility shims running a per-sample callback over a block.
+    static WaveformBlockFunc to_waveform_block_func(const WaveformFunc& func)
+    {
+      return [func](std::span<const float> phi, std::span<const float> param, std::span<float> out)
+      {
+        for (size_t i = 0; i < out.size(); ++i)
+          out[i] = func(phi[i], param[i]);
+      };
+    }
+    
+    static FrequencyBlockFunc to_frequency_block_func(const FrequencyFunc& func)
+    {
+      return [func](std::span<const float> t, float duration, float freq_0, std::span<float> out)
+      {
+        for (size_t i = 0; i < out.size(); ++i)
+          out[i] = func(t[i], duration, freq_0);
+      };
+    }
+    
+    // Used for both AmplitudeFunc and PhaseFunc as they share the same signature.
+    static AmplitudeBlockFunc to_amplitude_block_func(const AmplitudeFunc& func)
+    {
+      return [func](std::span<const float> t, float duration, std::span<float> out)
+      {
+        for (size_t i = 0; i < out.size(); ++i)
+          out[i] = func(t[i], duration);
+      };
+    }
+    
+    static std::pair<WaveformBlockFunc, int> extract_waveform_func(const WaveformFuncArg& wave_func_arg, bool verbose)
     {
       int enum_val = -1;
+      WaveformBlockFunc wave_func_block;
       WaveformFunc wave_func = waveform_sine;
-      std::visit([&wave_func, this, &enum_val, verbose](auto&& val)
+      std::visit([&wave_func, &wave_func_block, &enum_val, verbose](auto&& val)
       {
         using T = std::decay_t<decltype(val)>;
         if constexpr (std::is_same_v<T, WaveformType>)
@@ -280,14 +930,23 @@ namespace beat
           wave_func = val;
           if (verbose) std::cout << "WaveformType: Custom" << std::endl;
         }
+        else if constexpr (std::is_invocable_v<T, WAVEFORM_BLOCK_FUNC_ARGS>)
+        {
+          // Handle block std::function case
+          wave_func_block = val;
+          if (verbose) std::cout << "WaveformType: Custom (Block)" << std::endl;
+        }
       }, wave_func_arg);
-      return { wave_func, enum_val };
+      if (!wave_func_block)
+        wave_func_block = to_waveform_block_func(wave_func);
+      return { wave_func_block, enum_val };
     }
     
-    FrequencyFunc extract_frequency_func(const FrequencyFuncArg& freq_func_arg, bool verbose) const
+    static FrequencyBlockFunc extract_frequency_func(const FrequencyFuncArg& freq_func_arg, bool verbose)
     {
+      FrequencyBlockFunc freq_func_block;
       FrequencyFunc freq_func = freq_func_constant;
-      std::visit([&freq_func, this, verbose](auto&& val)
+      std::visit([&freq_func, &freq_func_block, verbose](auto&& val)
       {
         using T = std::decay_t<decltype(val)>;
         if constexpr (std::is_same_v<T, FrequencyType>)
@@ -324,14 +983,23 @@ namespace beat
           freq_func = val;
           if (verbose) std::cout << "FrequencyType: Custom" << std::endl;
         }
+        else if constexpr (std::is_invocable_v<T, FREQUENCY_BLOCK_FUNC_ARGS>)
+        {
+          // Handle block std::function case
+          freq_func_block = val;
+          if (verbose) std::cout << "FrequencyType: Custom (Block)" << std::endl;
+        }
       }, freq_func_arg);
-      return freq_func;
+      if (!freq_func_block)
+        freq_func_block = to_frequency_block_func(freq_func);
+      return freq_func_block;
     }
     
-    AmplitudeFunc extract_amplitude_func(const AmplitudeFuncArg& ampl_func_arg, bool verbose) const
+    static AmplitudeBlockFunc extract_amplitude_func(const AmplitudeFuncArg& ampl_func_arg, bool verbose)
     {
+      AmplitudeBlockFunc ampl_func_block;
       AmplitudeFunc ampl_func = ampl_func_constant;
-      std::visit([&ampl_func, this, verbose](auto&& val)
+      std::visit([&ampl_func, &ampl_func_block, verbose](auto&& val)
       {
         using T = std::decay_t<decltype(val)>;
         if constexpr (std::is_same_v<T, AmplitudeType>)
@@ -360,14 +1028,23 @@ namespace beat
           ampl_func = val;
           if (verbose) std::cout << "AmplitudeType: Custom" << std::endl;
         }
+        else if constexpr (std::is_invocable_v<T, AMPLITUDE_BLOCK_FUNC_ARGS>)
+        {
+          // Handle block std::function case
+          ampl_func_block = val;
+          if (verbose) std::cout << "AmplitudeType: Custom (Block)" << std::endl;
+        }
       }, ampl_func_arg);
-      return ampl_func;
+      if (!ampl_func_block)
+        ampl_func_block = to_amplitude_block_func(ampl_func);
+      return ampl_func_block;
     }
     
-    PhaseFunc extract_phase_func(const PhaseFuncArg& phase_func_arg, bool verbose) const
+    static PhaseBlockFunc extract_phase_func(const PhaseFuncArg& phase_func_arg, bool verbose)
     {
+      PhaseBlockFunc phase_func_block;
       PhaseFunc phase_func = phase_func_zero;
-      std::visit([&phase_func, this, verbose](auto&& val)
+      std::visit([&phase_func, &phase_func_block, verbose](auto&& val)
       {
         using T = std::decay_t<decltype(val)>;
         if constexpr (std::is_same_v<T, PhaseType>)
@@ -388,20 +1065,28 @@ namespace beat
           phase_func = val;
           if (verbose) std::cout << "PhaseType: Custom" << std::endl;
         }
+        else if constexpr (std::is_invocable_v<T, PHASE_BLOCK_FUNC_ARGS>)
+        {
+          // Handle block std::function case
+          phase_func_block = val;
+          if (verbose) std::cout << "PhaseType: Custom (Block)" << std::endl;
+        }
       }, phase_func_arg);
-      return phase_func;
+      if (!phase_func_block)
+        phase_func_block = to_amplitude_block_func(phase_func);
+      return phase_func_block;
     }
     
     // /////////////////////
     // Waveform Functions //
     // /////////////////////
-    const WaveformFunc waveform_sine = [](float phi, float /*param*/) -> float
+    static float calc_waveform_sine(float phi, float /*param*/)
     {
       //return args.amplitude * std::sin(2 * M_PI * args.frequency * t);
       return std::sin(phi);
-    };
+    }
     
-    const WaveformFunc waveform_square = [](float phi, float param) -> float
+    static float calc_waveform_square(float phi, float param)
     {
       auto duty_cycle = param;
 #if false
@@ -415,9 +1100,9 @@ namespace beat
         return +1.f;
       else
         return -1.f;
-    };
+    }
     
-    const WaveformFunc waveform_triangle = [](float phi, float param) -> float
+    static float calc_waveform_triangle(float phi, float param)
     {
       auto duty_cycle = param;
 #if false
@@ -435,9 +1120,9 @@ namespace beat
         return -1.f + 2.f*a/duty_cycle;
       else // if (a >= duty_cycle)
         return 1.f - 2.f*(a - duty_cycle)/(1 - duty_cycle);
-    };
+    }
     
-    const WaveformFunc waveform_sawtooth = [](float phi, float param) -> float
+    static float calc_waveform_sawtooth(float phi, float param)
     {
       auto duty_cycle = param;
       // x = max(0, mod(f*t, 1) - (1 - duty_cycle))/duty_cycle;
@@ -450,68 +1135,317 @@ namespace beat
 #endif
       a = std::max(0.f, a - (1.f - duty_cycle))/duty_cycle;
       return 2*a-1;
-    };
+    }
+    
+    // PolyBLEP residual of a unit step at phase 0.
+    // t: phase in [0, 1). dt: phase increment per sample.
+    static inline float poly_blep(float t, float dt)
+    {
+      if (t < dt)
+      {
+        float x = t/dt - 1.f;
+        return -0.5f*x*x;
+      }
+      else if (t > 1.f - dt)
+      {
+        float x = (t - 1.f)/dt + 1.f;
+        return 0.5f*x*x;
+      }
+      return 0.f;
+    }
+    
+    // PolyBLAMP residual of a unit change in slope (per sample) at phase 0.
+    static inline float poly_blamp(float t, float dt)
+    {
+      if (t < dt)
+      {
+        float x = 1.f - t/dt;
+        return x*x*x/6.f;
+      }
+      else if (t > 1.f - dt)
+      {
+        float x = (t - 1.f)/dt + 1.f;
+        return x*x*x/6.f;
+      }
+      return 0.f;
+    }
+    
+    static inline float wrap_phase(float a)
+    {
+      return a < 0.f ? a + 1.f : a;
+    }
     
-    const WaveformFunc waveform_noise = [](float phi, float /*param*/) -> float
+    static constexpr bool has_band_limited_waveform(WaveformType wave_type)
+    {
+      return wave_type == WaveformType::SQUARE
+        || wave_type == WaveformType::TRIANGLE
+        || wave_type == WaveformType::SAWTOOTH;
+    }
+    
+    // SQUARE, TRIANGLE and SAWTOOTH with the discontinuities in value and slope smoothed
+    // by PolyBLEP and PolyBLAMP. The ramps are never made shorter than one sample.
+    // dt: frequency / sample_rate.
+    template <WaveformType WT>
+    static inline float calc_waveform_band_limited(float phi, float param, float dt)
+    {
+      float a = phi / math::c_2pi;
+      a -= std::floor(a);
+      dt = std::min(std::abs(dt), 0.5f);
+      if constexpr (WT == WaveformType::SQUARE)
+      {
+        auto duty_cycle = param;
+        float val = a < duty_cycle ? +1.f : -1.f;
+        val += 2.f*poly_blep(a, dt);
+        val -= 2.f*poly_blep(wrap_phase(a - duty_cycle), dt);
+        return val;
+      }
+      else if constexpr (WT == WaveformType::TRIANGLE)
+      {
+        auto duty_cycle = math::clamp(param, dt, 1.f - dt);
+        float val = a < duty_cycle ? -1.f + 2.f*a/duty_cycle : 1.f - 2.f*(a - duty_cycle)/(1 - duty_cycle);
+        float slope_change = (2.f/duty_cycle + 2.f/(1.f - duty_cycle))*dt;
+        val += slope_change*poly_blamp(a, dt);
+        val -= slope_change*poly_blamp(wrap_phase(a - duty_cycle), dt);
+        return val;
+      }
+      else if constexpr (WT == WaveformType::SAWTOOTH)
+      {
+        auto duty_cycle = std::max(param, dt);
+        auto ramp_start = 1.f - duty_cycle;
+        float val = 2.f*std::max(0.f, a - ramp_start)/duty_cycle - 1.f;
+        float slope_change = 2.f/duty_cycle*dt;
+        val -= 2.f*poly_blep(a, dt);
+        val += slope_change*poly_blamp(wrap_phase(a - ramp_start), dt);
+        val -= slope_change*poly_blamp(a, dt);
+        return val;
+      }
+      else
+        return 0.f;
+    }
+    
+    static float calc_waveform_noise(float phi, float /*param*/)
     {
       return rnd::rand()*2.0f - 1.0f;
-    };
+    }
     
     // //////////////////////
     // Frequency Functions //
     // //////////////////////
-    const FrequencyFunc freq_func_constant = [](float t, float duration, float freq_0)
+    static float calc_freq_func_constant(float t, float duration, float freq_0)
     {
       return freq_0;
-    };
+    }
     
-    const FrequencyFunc freq_func_jet_engine_powerup = [](float t, float duration, float freq_0)
+    static float calc_freq_func_jet_engine_powerup(float t, float duration, float freq_0)
     {
-      return freq_0*(1 + rnd::rand_float(0, 2)*(0.5f + t));
-    };
+      return calc_freq_jet_engine_powerup(t, freq_0, rnd::rand_float(0, 2));
+    }
+    
+    // r: random number in [0, 2).
+    static inline float calc_freq_jet_engine_powerup(float t, float freq_0, float r)
+    {
+      return freq_0*(1 + r*(0.5f + t));
+    }
     
-    const FrequencyFunc freq_func_chirp_0 = [](float t, float duration, float freq_0)
+    static float calc_freq_func_chirp_0(float t, float duration, float freq_0)
     {
       return freq_0 + 0.5f*t;
-    };
+    }
     
-    const FrequencyFunc freq_func_chirp_1 = [](float t, float duration, float freq_0)
+    static float calc_freq_func_chirp_1(float t, float duration, float freq_0)
     {
       return freq_0 + 1.5f*t;
-    };
+    }
     
-    const FrequencyFunc freq_func_chirp_2 = [](float t, float duration, float freq_0)
+    static float calc_freq_func_chirp_2(float t, float duration, float freq_0)
     {
       return freq_0 + 4.f*t;
-    };
+    }
     
     // //////////////////////
     // Amplitude Functions //
     // //////////////////////
-    const AmplitudeFunc ampl_func_constant = [](float t, float duration)
+    static float calc_ampl_func_constant(float t, float duration)
     {
       return 1.f;
-    };
+    }
     
-    const AmplitudeFunc ampl_func_jet_engine_powerup = [](float t, float duration)
+    static float calc_ampl_func_jet_engine_powerup(float t, float duration)
     {
-      return math::linmap(t, 0.f, duration, 0.f, rnd::rand());
-    };
+      return calc_ampl_jet_engine_powerup(t, duration, rnd::rand());
+    }
     
-    const AmplitudeFunc ampl_func_vibrato_0 = [](float t, float duration)
+    // r: random number in [0, 1).
+    static inline float calc_ampl_jet_engine_powerup(float t, float duration, float r)
     {
-      return 0.8f + 0.2f*std::sin(math::c_2pi * 2.2f*t*(1 + std::min(0.8f, 0.4f*t)));
-    };
+      return math::linmap(t, 0.f, duration, 0.f, r);
+    }
+    
+    static float calc_ampl_func_vibrato_0(float t, float /*duration*/)
+    {
+      return calc_ampl_vibrato_0(t, MathPolicy::PRECISE);
+    }
+    
+    static inline float calc_ampl_vibrato_0(float t, MathPolicy math_policy)
+    {
+      return 0.8f + 0.2f*FastMath::sin(math::c_2pi * 2.2f*t*(1 + std::min(0.8f, 0.4f*t)), math_policy);
+    }
     
     // //////////////////
     // Phase Functions //
     // //////////////////
     
-    const PhaseFunc phase_func_zero = [](float t, float duration)
+    static float calc_phase_func_zero(float t, float duration)
     {
       return 0.f;
-    };
-
+    }
+    
+    // /////////////////////////
+    // Compile-time Selectors //
+    // /////////////////////////
+    // rs: Seeded random streams. Uses rnd::rand() if nullptr.
+    template <WaveformType WT>
+    static inline float calc_waveform(float phi, float param, RandomStreams* rs)
+    {
+      if constexpr (WT == WaveformType::SINE)
+        return calc_waveform_sine(phi, param);
+      else if constexpr (WT == WaveformType::SQUARE)
+        return calc_waveform_square(phi, param);
+      else if constexpr (WT == WaveformType::TRIANGLE)
+        return calc_waveform_triangle(phi, param);
+      else if constexpr (WT == WaveformType::SAWTOOTH)
+        return calc_waveform_sawtooth(phi, param);
+      else if (rs != nullptr)
+        return rs->wave.rand_float(-1.f, +1.f);
+      else
+        return calc_waveform_noise(phi, param);
+    }
+    
+    template <FrequencyType FT>
+    static inline float calc_frequency(float t, float duration, float freq_0, RandomStreams* rs)
+    {
+      if constexpr (FT == FrequencyType::CONSTANT)
+        return calc_freq_func_constant(t, duration, freq_0);
+      else if constexpr (FT == FrequencyType::JET_ENGINE_POWERUP)
+        return rs != nullptr ? calc_freq_jet_engine_powerup(t, freq_0, rs->freq.rand_float(0.f, 2.f))
+                             : calc_freq_func_jet_engine_powerup(t, duration, freq_0);
+      else if constexpr (FT == FrequencyType::CHIRP_0)
+        return calc_freq_func_chirp_0(t, duration, freq_0);
+      else if constexpr (FT == FrequencyType::CHIRP_1)
+        return calc_freq_func_chirp_1(t, duration, freq_0);
+      else
+        return calc_freq_func_chirp_2(t, duration, freq_0);
+    }
+    
+    template <AmplitudeType AT>
+    static inline float calc_amplitude(float t, float duration, RandomStreams* rs, MathPolicy math_policy)
+    {
+      if constexpr (AT == AmplitudeType::CONSTANT)
+        return calc_ampl_func_constant(t, duration);
+      else if constexpr (AT == AmplitudeType::JET_ENGINE_POWERUP)
+        return rs != nullptr ? calc_ampl_jet_engine_powerup(t, duration, rs->ampl.rand())
+                             : calc_ampl_func_jet_engine_powerup(t, duration);
+      else
+        return calc_ampl_vibrato_0(t, math_policy);
+    }
+    
+    // ////////////////////////////////////////////
+    // Type-erased Functions for the Generic Path //
+    // ////////////////////////////////////////////
+    static inline const WaveformFunc waveform_sine = calc_waveform_sine;
+    static inline const WaveformFunc waveform_square = calc_waveform_square;
+    static inline const WaveformFunc waveform_triangle = calc_waveform_triangle;
+    static inline const WaveformFunc waveform_sawtooth = calc_waveform_sawtooth;
+    static inline const WaveformFunc waveform_noise = calc_waveform_noise;
+    static inline const FrequencyFunc freq_func_constant = calc_freq_func_constant;
+    static inline const FrequencyFunc freq_func_jet_engine_powerup = calc_freq_func_jet_engine_powerup;
+    static inline const FrequencyFunc freq_func_chirp_0 = calc_freq_func_chirp_0;
+    static inline const FrequencyFunc freq_func_chirp_1 = calc_freq_func_chirp_1;
+    static inline const FrequencyFunc freq_func_chirp_2 = calc_freq_func_chirp_2;
+    static inline const AmplitudeFunc ampl_func_constant = calc_ampl_func_constant;
+    static inline const AmplitudeFunc ampl_func_jet_engine_powerup = calc_ampl_func_jet_engine_powerup;
+    static inline const AmplitudeFunc ampl_func_vibrato_0 = calc_ampl_func_vibrato_0;
+    static inline const PhaseFunc phase_func_zero = calc_phase_func_zero;
+  };
+  
+  // Resumable oscillator. Renders the same waveform as WaveformGeneration::generate_waveform()
+  // but in chunks of any size, carrying the phase, time, duty cycle, modulators and
+  // noise filter state between calls. No heap allocations are made when rendering.
+  // Unlike generate_waveform(), filtered noise is not normalized.
+  class Oscillator
+  {
+  public:
+    using WaveformFuncArg = WaveformGeneration::WaveformFuncArg;
+    using FrequencyFuncArg = WaveformGeneration::FrequencyFuncArg;
+    using AmplitudeFuncArg = WaveformGeneration::AmplitudeFuncArg;
+    using PhaseFuncArg = WaveformGeneration::PhaseFuncArg;
+    
+    // duration: Only used by frequency and amplitude functions that depend on it.
+    Oscillator(const WaveformFuncArg& wave_func_arg = WaveformType::SINE,
+               float duration = 10.f, std::optional<float> frequency = 440.f,
+               const WaveformGenerationParams& params = {},
+               int sample_rate = 44100,
+               const FrequencyFuncArg& freq_func_arg = FrequencyType::CONSTANT,
+               const AmplitudeFuncArg& ampl_func_arg = AmplitudeType::CONSTANT,
+               const PhaseFuncArg& phase_func_arg = PhaseType::ZERO)
+      : Oscillator(wave_func_arg, duration, frequency, CompiledWaveformGenerationParams(params), sample_rate,
+                   freq_func_arg, ampl_func_arg, phase_func_arg)
+    {}
+    
+    Oscillator(const WaveformFuncArg& wave_func_arg,
+               float duration, std::optional<float> frequency,
+               const CompiledWaveformGenerationParams& params,
+               int sample_rate = 44100,
+               const FrequencyFuncArg& freq_func_arg = FrequencyType::CONSTANT,
+               const AmplitudeFuncArg& ampl_func_arg = AmplitudeType::CONSTANT,
+               const PhaseFuncArg& phase_func_arg = PhaseType::ZERO)
+      : m_params(params)
+      , m_setup { frequency.value_or(440.f), frequency.has_value(), duration, sample_rate }
+    {
+      if (std::holds_alternative<WaveformType>(wave_func_arg)
+          && std::holds_alternative<FrequencyType>(freq_func_arg)
+          && std::holds_alternative<AmplitudeType>(ampl_func_arg)
+          && std::holds_alternative<PhaseType>(phase_func_arg))
+      {
+        m_wave_type = std::get<WaveformType>(wave_func_arg);
+        m_render_kernel = WaveformGeneration::select_render_kernel(m_wave_type.value(),
+                                                                   std::get<FrequencyType>(freq_func_arg),
+                                                                   std::get<AmplitudeType>(ampl_func_arg));
+      }
+      else
+      {
+        m_funcs = WaveformGeneration::extract_render_funcs(wave_func_arg, freq_func_arg, ampl_func_arg, phase_func_arg, false);
+        m_wave_type = m_funcs.wave_type;
+      }
+      m_state.emplace(m_params, m_setup, m_wave_type);
+    }
+    
+    // Renders the next out.size() samples.
+    void render(std::span<float> out)
+    {
+      if (m_render_kernel != nullptr)
+        m_render_kernel(out, m_params, m_setup, m_state.value());
+      else
+        WaveformGeneration::render_generic(out, m_params, m_setup, m_state.value(), m_funcs);
+    }
+    
+    // Restarts the oscillator from t = 0.
+    void reset()
+    {
+      m_state.emplace(m_params, m_setup, m_wave_type);
+    }
+    
+    // Time of the next sample to be rendered.
+    float get_time() const { return static_cast<float>(static_cast<double>(m_state->i) / m_setup.sample_rate); }
+    int get_sample_rate() const { return m_setup.sample_rate; }
+    
+  private:
+    CompiledWaveformGenerationParams m_params;
+    WaveformGeneration::RenderSetup m_setup;
+    std::optional<WaveformType> m_wave_type;
+    WaveformGeneration::RenderKernel m_render_kernel = nullptr;
+    WaveformGeneration::RenderFuncs m_funcs;
+    std::optional<WaveformGeneration::RenderState> m_state;
   };
   
 }
@@ -10,14 +10,28 @@
 #include "Waveform.h"
 #include "Spectrum.h"
 #include "ADSR.h"
+#include "EnvelopeGenerator.h"
+#include "PRNG.h"
+#include "FastMath.h"
+#include "FFT.h"
+#include "Convolver.h"
+#include "FilterProcessor.h"
+#include "MixBus.h"
+#include "Resampler.h"
 
 #include <Core/MathUtils.h>
 #include <Core/StlOperators.h>
 #include <Core/StlUtils.h>
 #include <Core/Rand.h>
 
+#include <array>
 #include <complex>
+#include <cstring>
 #include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <span>
 
 
 namespace beat
@@ -48,18 +62,111 @@ namespace beat
     bool normalize_filtered_wave = false;
   };
   
-  struct Filter
-  {
-    std::vector<float> a;
-    std::vector<float> b;
-  };
-  
   struct FilterS
   {
     std::vector<std::complex<double>> zeroes, poles;
     double gain = 1.f;
   };
   
+  // All the parameters that a filter design depends on.
+  struct FilterDesignKey
+  {
+    FilterType type = FilterType::NONE;
+    FilterOpType op_type = FilterOpType::NONE;
+    int order = 1;
+    float freq_cutoff_hz = 0.f;
+    std::optional<float> freq_bandwidth_hz = std::nullopt;
+    float ripple = 0.f;
+    int sample_rate = 44100;
+    
+    auto operator<=>(const FilterDesignKey&) const = default;
+  };
+  
+  // Thread-safe memoization of filter designs, shared by all threads.
+  // Holds at most capacity() designs and evicts the least recently used one when full.
+  class FilterDesignCache
+  {
+  public:
+    // Returns the cached design for key or calls design_func() to create it.
+    template<typename DesignFunc>
+    static FilterSOS get(const FilterDesignKey& key, DesignFunc design_func)
+    {
+      auto& c = instance();
+      {
+        std::scoped_lock lock(c.mutex);
+        auto it = c.designs.find(key);
+        if (it != c.designs.end())
+        {
+          c.lru.splice(c.lru.begin(), c.lru, it->second.second);
+          c.num_hits++;
+          return it->second.first;
+        }
+        c.num_misses++;
+      }
+      
+      // Design outside of the lock. Two threads may race to design the same filter, which is harmless.
+      FilterSOS sos = design_func();
+      
+      std::scoped_lock lock(c.mutex);
+      if (c.capacity == 0 || c.designs.contains(key))
+        return sos;
+      while (c.designs.size() >= c.capacity)
+      {
+        c.designs.erase(c.lru.back());
+        c.lru.pop_back();
+      }
+      c.lru.push_front(key);
+      c.designs.emplace(key, std::make_pair(sos, c.lru.begin()));
+      return sos;
+    }
+    
+    static size_t num_hits() { auto& c = instance(); std::scoped_lock lock(c.mutex); return c.num_hits; }
+    static size_t num_misses() { auto& c = instance(); std::scoped_lock lock(c.mutex); return c.num_misses; }
+    static size_t size() { auto& c = instance(); std::scoped_lock lock(c.mutex); return c.designs.size(); }
+    static size_t capacity() { auto& c = instance(); std::scoped_lock lock(c.mutex); return c.capacity; }
+    
+    // A capacity of zero disables caching.
+    static void set_capacity(size_t capacity)
+    {
+      auto& c = instance();
+      std::scoped_lock lock(c.mutex);
+      c.capacity = capacity;
+      while (c.designs.size() > c.capacity)
+      {
+        c.designs.erase(c.lru.back());
+        c.lru.pop_back();
+      }
+    }
+    
+    // Removes all designs and resets the hit and miss counters.
+    static void clear()
+    {
+      auto& c = instance();
+      std::scoped_lock lock(c.mutex);
+      c.designs.clear();
+      c.lru.clear();
+      c.num_hits = 0;
+      c.num_misses = 0;
+    }
+    
+  private:
+    struct State
+    {
+      std::mutex mutex;
+      std::list<FilterDesignKey> lru; // Most recently used first.
+      std::map<FilterDesignKey, std::pair<FilterSOS, std::list<FilterDesignKey>::iterator>> designs;
+      size_t capacity = 256;
+      size_t num_hits = 0;
+      size_t num_misses = 0;
+    };
+    
+    static State& instance()
+    {
+      static State s_state;
+      return s_state;
+    }
+  };
+  
   class WaveformHelper
   {
     enum class ConvRange { Full, Same, Valid };
@@ -100,26 +207,64 @@ namespace beat
           No = std::max(0, Ni - Nk + 1);
           break;
       }
-      auto pad_vec_L = stlutils::repval<float>(0, pad_L);
-      auto pad_vec_R = stlutils::repval<float>(0, pad_R);
-      auto xx = stlutils::cat(pad_vec_L, x, pad_vec_R);
+      std::vector<float> xx(pad_L + Ni + pad_R, 0.f);
+      std::copy(x.begin(), x.end(), xx.begin() + pad_L);
       auto kk = w_kernel;
       if (type == ConvType::Convolution)
         std::reverse(kk.begin(), kk.end());
       std::vector<float> y(No);
-      for (int o_idx = 0; o_idx < No; ++o_idx)
-        y[o_idx] = stlutils::dot(stlutils::subset(xx, o_idx, o_idx + Nk - 1), kk) + bias;
+      Convolver::correlate(xx, kk, y);
+      if (bias != 0.f)
+        for (auto& s : y)
+          s += bias;
       return y;
     }
   
+    // Full linear convolution. Direct for short signals or kernels, else via the real-input FFT
+    //   padded to the smallest even fast size that fits the result.
+    static std::vector<float> conv_full(const std::vector<float>& x, const std::vector<float>& kernel)
+    {
+      if (x.empty() || kernel.empty())
+        return {};
+      if (Convolver::prefer_direct(x.size(), kernel.size()))
+        return Convolver::convolve_direct(x, kernel);
+      
+      auto conv_full_size = static_cast<int>(x.size() + kernel.size() - 1);
+      auto N = 2 * FFTPlan::next_fast_size((conv_full_size + 1) / 2);
+      auto& plan = FFTPlan::get(N);
+      std::vector<float> xx(N, 0.f);
+      std::vector<float> kk(N, 0.f);
+      std::copy(x.begin(), x.end(), xx.begin());
+      std::copy(kernel.begin(), kernel.end(), kk.begin());
+      std::vector<std::complex<float>> spec_x(N/2 + 1);
+      std::vector<std::complex<float>> spec_k(N/2 + 1);
+      plan.forward_real(xx, spec_x);
+      plan.forward_real(kk, spec_k);
+      for (int i = 0; i <= N/2; ++i)
+        spec_x[i] *= spec_k[i] / static_cast<float>(N);
+      plan.inverse_real(spec_x, xx);
+      xx.resize(conv_full_size);
+      return xx;
+    }
+  
   public:
     static Waveform subset(const Waveform& wave, size_t start_idx, size_t length = static_cast<size_t>(-1))
+    {
+      Waveform output;
+      subset(wave, output, start_idx, length);
+      return output;
+    }
+    
+    // Writes the subset to output, reusing its buffer. output may be wave itself.
+    static void subset(const Waveform& wave, Waveform& output, size_t start_idx, size_t length = static_cast<size_t>(-1))
     {
       auto N = wave.buffer.size();
       if (N == 0)
-        return {};
+      {
+        output = {};
+        return;
+      }
         
-      Waveform output;
       output.copy_properties(wave);
       
       if (start_idx < N)
@@ -130,63 +275,70 @@ namespace beat
         size_t N_new = length;
         if (start_idx + length > N)
           N_new = N - start_idx;
+        if (&output != &wave)
+          output.buffer.resize(N_new);
+        std::memmove(output.buffer.data(), wave.buffer.data() + start_idx, N_new * sizeof(wave.buffer[0]));
         output.buffer.resize(N_new);
-        std::memcpy(output.buffer.data(), wave.buffer.data() + start_idx, N_new * sizeof(wave.buffer[0]));
       }
+      else
+        output.buffer.clear();
         
       output.update_duration();
-      return output;
     }
   
     static Waveform mix(const std::vector<std::pair<float, Waveform>>& weighted_waves)
     {
-      const size_t Nw = weighted_waves.size();
-      size_t Nmin = static_cast<size_t>(-1);
-      std::vector<std::pair<float, Waveform>> res_weighted_waves(weighted_waves.size());
+      Waveform weighted_sum;
+      mix(weighted_waves, weighted_sum);
+      return weighted_sum;
+    }
+    
+    // Writes the weighted sum to output, reusing its buffer. output must not be one of the weighted waves.
+    static void mix(const std::vector<std::pair<float, Waveform>>& weighted_waves, Waveform& output)
+    {
+      std::vector<std::pair<float, const Waveform*>> weighted_wave_ptrs;
+      for (const auto& [weight, wave] : weighted_waves)
+        weighted_wave_ptrs.emplace_back(weight, &wave);
+      mix(weighted_wave_ptrs, output);
+    }
+    
+    // Same as above but via MixBus without copying the waveforms in.
+    // pad_to_longest: Mixes up to the end of the longest waveform instead of the shortest,
+    //   with the shorter ones padded with zeros.
+    static Waveform mix(const std::vector<std::pair<float, const Waveform*>>& weighted_waves, bool pad_to_longest = false)
+    {
+      Waveform weighted_sum;
+      mix(weighted_waves, weighted_sum, pad_to_longest);
+      return weighted_sum;
+    }
+    
+    static void mix(const std::vector<std::pair<float, const Waveform*>>& weighted_waves, Waveform& output,
+                    bool pad_to_longest = false)
+    {
       int common_sample_rate = 0;
       float frequency = 0.f;
-      float weight_sum = 0.f;
-      for (const auto& ww : weighted_waves)
+      MixBus bus;
+      for (const auto& [weight, wave] : weighted_waves)
       {
-        const auto weight = ww.first;
-        const auto& wave = ww.second;
-        math::maximize(common_sample_rate, wave.sample_rate);
-        frequency += wave.frequency;
-        math::minimize(Nmin, wave.buffer.size());
-        weight_sum += weight;
+        math::maximize(common_sample_rate, wave->sample_rate);
+        frequency += wave->frequency;
+        bus.add_input(wave->buffer, weight);
       }
-      frequency /= Nw;
-      for (size_t w_idx = 0; w_idx < Nw; ++w_idx)
-      {
-        const auto& ww_i = weighted_waves[w_idx];
-        const auto& wave_i = ww_i.second;
-        auto& ww_o = res_weighted_waves[w_idx];
-        ww_o.first = ww_i.first;
-        ww_o.second = resample(wave_i, common_sample_rate, FilterType::Butterworth);
-      }
-    
-      Waveform weighted_sum(Nmin, 0.f);
-      weighted_sum.sample_rate = common_sample_rate;
-      weighted_sum.frequency = frequency;
       
-      for (size_t i = 0; i < Nmin; ++i)
-      {
-        weighted_sum.buffer[i] = 0.f;
-        for (const auto& ww : weighted_waves)
-          weighted_sum.buffer[i] += ww.first * ww.second.buffer[i];
-        weighted_sum.buffer[i] /= weight_sum;
-      }
+      output.buffer.resize(bus.length(pad_to_longest));
+      output.sample_rate = common_sample_rate;
+      output.frequency = frequency / weighted_waves.size();
+      bus.mix(output.buffer, 0, true);
       
-      weighted_sum.update_duration();
-      return weighted_sum;
+      output.update_duration();
     }
   
     static Waveform mix(float t, const Waveform& wave_A, const Waveform& wave_B)
     {
       // Resample both signals to a common sample rate
       int common_sample_rate = std::max(wave_A.sample_rate, wave_B.sample_rate);
-      Waveform res_A = resample(wave_A, common_sample_rate, FilterType::Butterworth);
-      Waveform res_B = resample(wave_B, common_sample_rate, FilterType::Butterworth);
+      Waveform res_A = resample(wave_A, common_sample_rate, ResamplerQuality::MEDIUM);
+      Waveform res_B = resample(wave_B, common_sample_rate, ResamplerQuality::MEDIUM);
       
       const auto Nmin = std::min(res_A.buffer.size(), res_A.buffer.size());
       Waveform sum(Nmin, 0.f);
@@ -200,30 +352,39 @@ namespace beat
     }
   
     static Waveform ring_modulation(const Waveform& wave_A, const Waveform& wave_B)
+    {
+      Waveform prod = wave_A;
+      apply_ring_modulation(prod, wave_B);
+      return prod;
+    }
+    
+    // In-place version of ring_modulation(). Only allocates if the sample rates differ.
+    static void apply_ring_modulation(Waveform& wave_A, const Waveform& wave_B)
     {
       // Resample both signals to a common sample rate
       int common_sample_rate = std::max(wave_A.sample_rate, wave_B.sample_rate);
-      Waveform res_A = resample(wave_A, common_sample_rate, FilterType::Butterworth);
-      Waveform res_B = resample(wave_B, common_sample_rate, FilterType::Butterworth);
-      
-      
-      Waveform prod;
-      prod.sample_rate = common_sample_rate;
-      prod.frequency = calc_fundamental_frequency(res_A.frequency, res_B.frequency);
-      
-      int Nmin = static_cast<int>(std::min(res_A.buffer.size(), res_B.buffer.size()));
-      prod.buffer.resize(Nmin);
-      
-      for (int i = 0; i < Nmin; ++i)
+      if (wave_A.sample_rate != common_sample_rate)
+        resample(wave_A, wave_A, common_sample_rate, ResamplerQuality::MEDIUM);
+      Waveform res_B;
+      const Waveform* wave_B_res = &wave_B;
+      if (wave_B.sample_rate != common_sample_rate)
       {
-        float a = res_A.buffer[i];
-        float b = res_B.buffer[i];
-        prod.buffer[i] = a * b;
+        resample(wave_B, res_B, common_sample_rate, ResamplerQuality::MEDIUM);
+        wave_B_res = &res_B;
       }
       
-      prod.duration = calc_duration(prod);
-      
-      return prod;
+      wave_A.buffer.resize(std::min(wave_A.buffer.size(), wave_B_res->buffer.size()));
+      apply_ring_modulation(wave_A.buffer, wave_B_res->buffer);
+      wave_A.frequency = calc_fundamental_frequency(wave_A.frequency, wave_B_res->frequency);
+      wave_A.duration = calc_duration(wave_A);
+    }
+    
+    // a[i] *= b[i] for the common length.
+    static void apply_ring_modulation(std::span<float> a, std::span<const float> b)
+    {
+      const size_t N = std::min(a.size(), b.size());
+      for (size_t i = 0; i < N; ++i)
+        a[i] *= b[i];
     }
     
     // wave: the waveform to produce a reverb effect for.
@@ -232,15 +393,14 @@ namespace beat
     {
       // Resample both signals to a common sample rate.
       int common_sample_rate = std::max(wave.sample_rate, kernel.sample_rate);
-      Waveform res_wave = resample(wave, common_sample_rate, FilterType::Butterworth);
-      Waveform res_kernel = resample(kernel, common_sample_rate, FilterType::Butterworth);
+      Waveform res_wave = resample(wave, common_sample_rate, ResamplerQuality::MEDIUM);
+      Waveform res_kernel = resample(kernel, common_sample_rate, ResamplerQuality::MEDIUM);
       
       Waveform conv;
       conv.sample_rate = common_sample_rate;
       conv.frequency = calc_fundamental_frequency(res_wave.frequency, res_kernel.frequency);
       
-      conv.buffer = conv_1d(res_wave.buffer, res_kernel.buffer, 0.f,
-                            ConvRange::Full, ConvType::Convolution);
+      conv.buffer = conv_full(res_wave.buffer, res_kernel.buffer);
                                        
       normalize_over(conv);
       //auto [minval, maxval] = WaveformHelper::find_min_max(conv, true);
@@ -252,41 +412,77 @@ namespace beat
       return conv;
     }
     
-    static Waveform reverb_fast(const Waveform& wave, const Waveform& kernel)
+    // Reverb with a precomputed impulse response so that its spectra are not recomputed for every call.
+    // The waveform is resampled to the sample rate of the impulse response.
+    static Waveform reverb(const Waveform& wave, const ImpulseResponse& ir, int ir_channel = 0)
+    {
+      Waveform res_wave = resample(wave, ir.sample_rate(), ResamplerQuality::MEDIUM);
+      
+      Convolver convolver(ir, ir_channel);
+      Waveform reverb;
+      reverb.buffer = convolver.convolve(res_wave.buffer);
+      reverb.sample_rate = ir.sample_rate();
+      reverb.frequency = calc_fundamental_frequency(res_wave.frequency, ir.frequency());
+      reverb.update_duration();
+      
+      // Normalize to amplitude max 1 if amplitude > 1.
+      normalize_over(reverb);
+      
+      return reverb;
+    }
+    
+    // Same channel combinations as apply_channelwise():
+    //   equal number of channels, mono waveform with stereo IR or stereo waveform with mono IR.
+    static std::vector<Waveform> reverb(const std::vector<Waveform>& wave_channels, const ImpulseResponse& ir)
+    {
+      auto num_channels_w = stlutils::sizeI(wave_channels);
+      auto num_channels_ir = ir.num_channels();
+      auto num_channels_r = std::max(num_channels_w, num_channels_ir);
+      std::vector<Waveform> wave_r_channels(num_channels_r);
+      
+      if (num_channels_w == num_channels_ir)
+      {
+        for (int ch = 0; ch < num_channels_r; ++ch)
+          wave_r_channels[ch] = reverb(wave_channels[ch], ir, ch);
+      }
+      else if (num_channels_w == 1 && num_channels_ir == 2)
+      {
+        for (int ch = 0; ch < num_channels_r; ++ch)
+          wave_r_channels[ch] = reverb(wave_channels[0], ir, ch);
+      }
+      else if (num_channels_w == 2 && num_channels_ir == 1)
+      {
+        for (int ch = 0; ch < num_channels_r; ++ch)
+          wave_r_channels[ch] = reverb(wave_channels[ch], ir, 0);
+      }
+      
+      return wave_r_channels;
+    }
+    
+    // Picks direct convolution for short kernels and FFT convolution for long ones.
+    // block_size: If > 0, convolves block by block with a partitioned Convolver
+    //   instead of one FFT over the whole signal, which needs much less memory for long signals.
+    static Waveform reverb_fast(const Waveform& wave, const Waveform& kernel, int block_size = 0)
     {
       // Resample both signals to a common sample rate.
       int common_sample_rate = std::max(wave.sample_rate, kernel.sample_rate);
-      Waveform res_wave = resample(wave, common_sample_rate, FilterType::Butterworth);
-      Waveform res_kernel = resample(kernel, common_sample_rate, FilterType::Butterworth);
+      Waveform res_wave = resample(wave, common_sample_rate, ResamplerQuality::MEDIUM);
+      Waveform res_kernel = resample(kernel, common_sample_rate, ResamplerQuality::MEDIUM);
       
       // Apply windowing.
       //apply_window(res_wave, WindowType::HAMMING);
       //apply_window(res_kernel, WindowType::HAMMING);
       
-      // Padding to common length.
-      auto Nw = static_cast<int>(res_wave.buffer.size());
-      auto Nk = static_cast<int>(res_kernel.buffer.size());
-      auto N = static_cast<int>(std::max(Nw, Nk));
-      for (int i = 0; i < N - Nw; ++i)
-        res_wave.buffer.emplace_back(0.f);
-      for (int i = 0; i < N - Nk; ++i)
-        res_kernel.buffer.emplace_back(0.f);
-      
-      auto spec_res_wave = fft(res_wave);
-      auto spec_res_kernel = fft(res_kernel);
-      
-      int Ns = static_cast<int>(spec_res_wave.buffer.size());
-      Spectrum prod;
-      prod.buffer.resize(Ns);
-      for (int i = 0; i < Ns; ++i)
-        prod.buffer[i] = spec_res_wave.buffer[i] * spec_res_kernel.buffer[i];
-      prod.copy_properties(spec_res_wave);
-      
-      auto reverb = ifft(prod);
-      auto conv_full_size = Nw + Nk - 1;
+      Waveform reverb;
+      if (block_size > 0)
+      {
+        Convolver convolver(res_kernel.buffer, block_size);
+        reverb.buffer = convolver.convolve(res_wave.buffer);
+      }
+      else
+        reverb.buffer = conv_full(res_wave.buffer, res_kernel.buffer);
       //reverb.buffer.resize(std::min(reverb.buffer.size(), res_kernel.buffer.size()));
       //reverb.buffer.resize(std::min(reverb.buffer.size(), res_wave.buffer.size()));
-      reverb.buffer.resize(conv_full_size);
       reverb.sample_rate = common_sample_rate;
       reverb.frequency = calc_fundamental_frequency(res_wave.frequency, res_kernel.frequency);
       reverb.update_duration();
@@ -362,20 +558,38 @@ namespace beat
       return output;
     }
     
-    static Spectrum fft(const Waveform& wave)
+    // Transforms all N samples without padding. Lengths with prime factors other than
+    //   2, 3, 5 and 7 are supported but slower, see FFTPlan::next_fast_size().
+    // half_spectrum: Only returns the N/2 + 1 non-redundant bins from 0 Hz to Nyquist.
+    //   Uses a real-input FFT which takes about half the time and memory.
+    //   Odd lengths are zero-padded by one sample.
+    static Spectrum fft(const Waveform& wave, bool half_spectrum = false)
     {
       auto sz = static_cast<int>(wave.buffer.size());
-      auto N = static_cast<int>(std::pow<int>(2, std::ceil(std::log(sz)/std::log(2))));
+      
+      if (half_spectrum)
+      {
+        auto N = sz > 1 ? sz + sz % 2 : sz;
+        Spectrum result;
+        result.half_spectrum = true;
+        result.freq_start = 0.f;
+        result.freq_end = wave.sample_rate / 2.f;
+        if (N > 0)
+        {
+          std::vector<float> input(N, 0.f);
+          std::copy(wave.buffer.begin(), wave.buffer.end(), input.begin());
+          result.buffer.resize(N/2 + 1);
+          FFTPlan::get(N).forward_real(input, result.buffer);
+        }
+        return result;
+      }
     
       std::vector<std::complex<float>> input(std::begin(wave.buffer), std::end(wave.buffer));
-      // Padding.
-      for (int i = 0; i < N - sz; ++i)
-        input.emplace_back(0.f);
-      
-      auto output = fft_rec(input);
+      if (sz > 0)
+        FFTPlan::get(sz).forward(input);
       
       Spectrum result;
-      result.buffer = output;
+      result.buffer = std::move(input);
       // Calculate frequency axis.
       result.freq_start = -wave.sample_rate / 2.f;
       result.freq_end = wave.sample_rate / 2.f;
@@ -385,22 +599,32 @@ namespace beat
     
     static Waveform ifft(const Spectrum& spectrum, Complex2Real c2r_filter = Complex2Real::REAL)
     {
-      auto sz = static_cast<int>(spectrum.buffer.size());
-      auto N = static_cast<int>(std::pow<int>(2, std::ceil(std::log(sz)/std::log(2))));
+      if (spectrum.half_spectrum)
+      {
+        // The inverse of a half spectrum is real.
+        auto N = static_cast<int>(spectrum.signal_length());
+        Waveform result;
+        result.buffer.resize(N);
+        if (N > 0)
+          FFTPlan::get(N).inverse_real(spectrum.buffer, result.buffer);
+        for (auto& s : result.buffer)
+          s = complex2real(s / static_cast<float>(N), c2r_filter);
+        result.sample_rate = static_cast<int>(spectrum.freq_end * 2.f);
+        return result;
+      }
+      
+      auto N = static_cast<int>(spectrum.buffer.size());
     
       std::vector<std::complex<float>> input(std::begin(spectrum.buffer), std::end(spectrum.buffer));
-      // Padding.
-      for (int i = 0; i < N - sz; ++i)
-        input.emplace_back(0.f);
-      
-      auto output = ifft_rec(input);
+      if (N > 0)
+        FFTPlan::get(N).inverse(input);
       
       // Normalize the output.
-      for (auto& s : output)
+      for (auto& s : input)
         s /= static_cast<float>(N);
       
       Waveform result;
-      result.buffer = complex2real(output, c2r_filter);
+      result.buffer = complex2real(input, c2r_filter);
       // Calculate frequency axis.
       result.sample_rate = static_cast<int>(spectrum.freq_end * 2.f);
       
@@ -562,15 +786,21 @@ namespace beat
       return output;
     }
     
-    static Waveform flanger(const Waveform& wave, float delay_time, float rate, float feedback)
+    // math_policy: FAST evaluates the LFO with the SIMD FastMath::sin().
+    static Waveform flanger(const Waveform& wave, float delay_time, float rate, float feedback,
+                            MathPolicy math_policy = MathPolicy::PRECISE)
     {
       Waveform output = wave;
-      
-      output.buffer = flanger(wave.buffer, delay_time, rate, feedback, wave.sample_rate);
-   
+      apply_flanger(output, delay_time, rate, feedback, math_policy);
       return output;
     }
     
+    static void apply_flanger(Waveform& wave, float delay_time, float rate, float feedback,
+                              MathPolicy math_policy = MathPolicy::PRECISE)
+    {
+      flanger(wave.buffer, wave.buffer, delay_time, rate, feedback, wave.sample_rate, math_policy);
+    }
+    
     // #FIXME: Why you not work!?!?
     static Waveform fir_chorus(const Waveform& wave, float modulation_freq = 1.f, float modulation_depth = 5e-3f, const std::vector<float> coeffs = { 1.f, .5f, -.2f, .1f })
     {
@@ -595,8 +825,10 @@ namespace beat
     }
     
     // Emulates string instrument sounds.
+    // seed: Uses a seeded PRNG for the initial noise burst if set, otherwise rnd::rand_float().
     static Waveform karplus_strong(float duration_s, float frequency,
-                                   int sample_rate = 44100)
+                                   int sample_rate = 44100,
+                                   std::optional<uint64_t> seed = std::nullopt)
     {
       auto Ns = static_cast<int>(calc_num_samples(duration_s, sample_rate));
       Waveform wave(Ns, 0.f);
@@ -606,8 +838,11 @@ namespace beat
       auto Nb = std::min(Ns, static_cast<int>(std::round(sample_rate / frequency)));
       
       std::vector<float> noise(Nb);
-      for (int s_idx = 0; s_idx < Nb; ++s_idx)
-        noise[s_idx] = rnd::rand_float(-1.f, +1.f);
+      if (seed.has_value())
+        PRNG(seed.value()).fill(noise, -1.f, +1.f);
+      else
+        for (int s_idx = 0; s_idx < Nb; ++s_idx)
+          noise[s_idx] = rnd::rand_float(-1.f, +1.f);
       
       // y(n) = x(n) + (y(n-N) + y(n-N+1))/2
       
@@ -623,262 +858,69 @@ namespace beat
       return wave;
     }
     
-    static Waveform envelope_adsr(const Waveform& wave, const ADSR& adsr)
+    // math_policy: FAST uses the FastMath approximation of log for the LOG shapes.
+    static Waveform envelope_adsr(const Waveform& wave, const ADSR& adsr,
+                                  MathPolicy math_policy = MathPolicy::PRECISE)
     {
-      auto N = wave.buffer.size();
       Waveform output = wave;
-      
-      // Ex0:
-      // t_a               t_ad               t_ds                   t_sr               t_r
-      // |----- T_a_s ----->|----- T_d_s ----->|----- T_s_max_s ----->|----- T_r_s ----->|
-      // |-------------------------------- T_dur_s ----------------------------------------------------->|
-      //
-      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
-      // t_a = 0, t_ad = .10, t_ds = .20, t_sr = .35, t_r = .45
-      // T_dur_s = .60
-      // t_ad = T_a_s = .10
-      // t_ds = T_a_s + T_d_s = 0.10 + 0.10 = 0.20
-      // t_sr = T_a_s + T_d_s + T_s_max_s = 0.10 + 0.10 + 0.15 = 0.35
-      // t_r = T_a_s + T_d_s + T_s_max_s + T_r_s = .10 + .10 + .15 + .10 = .45
-      
-      // Ex1:
-      // t_a               t_ad               t_ds               t_sr               t_r
-      // |----- T_a_s ----->|----- T_d_s ----->|----- T_s_s ----->|----- T_r_s ----->|
-      // |-------------------------------- T_dur_s --------------------------------->|
-      //
-      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
-      // t_a = 0, t_ad = .10, t_ds = .20, t_sr = .30, t_r = .40
-      // T_dur_s = .40
-      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.40 - .10, 0) = 0.30
-      // t_ad = min(T_ads_s, T_a_s) = min(0.30, 0.10) = 0.10 = T_a_s (original)
-      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0.30, 0.10 + 0.10) = 0.20 = T_a_s + T_d_s (original)
-      // t_sr = max(t_ds, T_ads_s) = max(0.20, 0.30) = 0.30
-      // t_r = T_dur_s = 0.40
-      
-      // Ex2:
-      // |----- T_a_s ----->|----- T_d_s ----->|- T_s_s ->|----- T_r_s ----->|
-      // |---------------------------- T_dur_s ----------------------------->|
-      
-      // Ex3:
-      // |----- T_a_s ----->|----- T_d_s ----->|----- T_r_s ----->|
-      // |------------------------ T_dur_s ---------------------->|
-      //
-      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
-      
-      // Ex4:
-      // t_a              t_ad      t_ds/t_sr            t_r
-      // |----- T_a_s ----->|- T_d_s ->|----- T_r_s ----->|
-      // |-------------------- T_dur_s ------------------>|
-      //
-      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
-      // t_a = 0, t_ad = .10, t_ds = .15, t_sr = .15, t_r = .25
-      // T_dur_s = .25
-      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.25 - .10, 0) = 0.15
-      // t_ad = min(T_ads_s, T_a_s) = min(0.15, 0.10) = 0.10 = T_a_s (original)
-      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0.15, 0.10 + 0.10) = 0.15 < 0.20 = T_a_s + T_d_s
-      // t_sr = max(t_ds, T_ads_s) = max(0.15, 0.15) = 0.15
-      // t_r = T_dur_s = 0.25
-      
-      // Ex5:
-      // t_a          t_ad/t_ds/t_sr          t_r
-      // |----- T_a_s ----->|----- T_r_s ----->|
-      // |-------------- T_dur_s ------------->|
-      //
-      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
-      // t_a = 0, t_ad = .10, t_ds = .10, t_sr = .10, t_r = .20
-      // T_dur_s = .20
-      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.20 - .10, 0) = 0.10
-      // t_ad = min(T_ads_s, T_a_s) = min(0.10, 0.10) = 0.10 = T_a_s (original)
-      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0.10, 0.10 + 0.10) = 0.10 < 0.20 = T_a_s + T_d_s
-      // t_sr = max(t_ds, T_ads_s) = max(0.10, 0.10) = 0.10
-      // t_r = T_dur_s = 0.20
-      
-      // Ex6:
-      // t_a  t_ad/t_ds/t_sr          t_r
-      // |- T_a_s ->|----- T_r_s ----->|
-      // |---------- T_dur_s --------->|
-      //
-      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
-      // t_a = 0, t_ad = .05, t_ds = .05, t_sr = .05, t_r = .15
-      // T_dur_s = .15
-      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.15 - .10, 0) = 0.05
-      // t_ad = min(T_ads_s, T_a_s) = min(0.05, 0.10) = 0.05 < 0.10 = T_a_s
-      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0.05, 0.10 + 0.10) = 0.05 < 0.20 = T_a_s + T_d_s
-      // t_sr = max(t_ds, T_ads_s) = max(0.05, 0.05) = 0.05
-      // t_r = T_dur_s = 0.15
-      
-      // Ex7:
-      // t_a/t_ad/t_ds/t_sr        t_r
-      //         |----- T_r_s ----->|
-      //         |----- T_dur_s --->|
-      //
-      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
-      // t_a = 0, t_ad = 0, t_ds = 0, t_sr = 0, t_r = .10
-      // T_dur_s = .10
-      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.10 - .10, 0) = 0
-      // t_ad = min(T_ads_s, T_a_s) = min(0, 0.10) = 0 < 0.10 = T_a_s
-      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0, 0.10 + 0.10) = 0 < 0.20 = T_a_s + T_d_s
-      // t_sr = max(t_ds, T_ads_s) = max(0, 0) = 0
-      // t_r = T_dur_s = 0.10
-      
-      // Ex8:
-      // t_a/t_ad/t_ds/t_sr           t_r
-      //                |- T_r_s ->|
-      //                |--------->| T_dur_s
-      //
-      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
-      // t_a = 0, t_ad = 0, t_ds = 0, t_sr = 0, t_r = .05
-      // T_dur_s = .05
-      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(.05 - .10, 0) = 0
-      // t_ad = min(T_ads_s, T_a_s) = min(0, 0.10) = 0 < 0.10 = T_a_s
-      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0, 0.10 + 0.10) = 0 < 0.20 = T_a_s + T_d_s
-      // t_sr = max(t_ds, T_ads_s) = max(0, 0) = 0
-      // t_r = T_dur_s = 0.05
-      
-      // Ex9:
-      // t_a/t_ad/t_ds/t_sr/t_r
-      //                   |
-      //                   | T_dur_s
-      //
-      // T_a_s = .10, T_d_s = .10, (T_s_s = *), T_r_s = .10
-      // t_a = 0, t_ad = 0, t_ds = 0, t_sr = 0, t_r = 0
-      // T_dur_s = 0
-      // T_ads_s = max(T_dur_s - T_r_s, 0) = max(0 - .10, 0) = 0
-      // t_ad = min(T_ads_s, T_a_s) = min(0, 0.10) = 0 < 0.10 = T_a_s
-      // t_ds = min(T_ads_s, T_a_s + T_d_s) = min(0, 0.10 + 0.10) = 0 < 0.20 = T_a_s + T_d_s
-      // t_sr = max(t_ds, T_ads_s) = max(0, 0) = 0
-      // t_r = T_dur_s = 0
-      
-      using namespace stloperators;
-      
-      //   T_dur_s = T_a_s + T_d_s + T_s + T_r_s.
-      const float T_dur_s = output.duration;
-      const float T_a_s = adsr.get_time_A_ms() * 1e-3f;
-      const float T_d_s = adsr.get_time_D_ms() * 1e-3f;
-      const std::optional<float> T_s_max_s = adsr.get_max_time_S_ms() * 1e-3f;
-      const float T_r_s = adsr.get_time_R_ms() * 1e-3f;
-      
-      const float t_a = 0.f;
-      const float T_ads_s = std::max(T_dur_s - T_r_s, 0.f);
-      float t_ad = std::min(T_ads_s, T_a_s);
-      float t_ds = std::min(T_ads_s, T_a_s + T_d_s);
-      float t_sr = std::max(t_ds, T_ads_s); // T_dur_s - T_a_s - T_d_s - T_r_s;
-      float t_r = T_dur_s;
-      if (T_s_max_s.has_value())
-      {
-        auto T_adsr_s = T_a_s + T_d_s + T_s_max_s.value() + T_r_s;
-        if (T_adsr_s < T_dur_s)
-        {
-          t_ad = T_a_s;
-          t_ds = t_ad + T_d_s;
-          t_sr = t_ds + T_s_max_s.value();
-          t_r = t_sr + T_r_s;
-        }
-      }
-      
-      float dt = calc_dt(wave);
-      float t = 0.f;
-      for (size_t i = 0; i < N; ++i)
-      {
-        t = i * dt;
-        //std::cout << t << '\n';
-        auto& s = output.buffer[i];
-        float env = 0.f;
-        float p = 0.f; // Param.
-        float pl = 0.f; // Linear Param.
-        
-        if (math::in_range(t, t_a, t_ad, Range::Closed))
-        {
-          //std::cout << "A";
-          pl = math::value_to_param(t, t_a, t_ad);
-          switch (adsr.get_shape_A())
-          {
-            case ADSRMode::LIN:
-              p = pl;
-              //env = math::linmap(t, t_a, t_ad, 0.f, 1.f);
-              break;
-            case ADSRMode::EXP:
-              p = std::exp(pl * math::c_ln2) - 1;
-              //env = std::exp(math::c_ln2 * (t - t_a)/attack_s) - 1;
-              break;
-            case ADSRMode::LOG:
-              p = std::log(pl * (math::c_e - 1) + 1);
-              //env = std::log((t - t_a)/attack_s*(math::c_e - 1) + 1);
-              break;
-          }
-          env = math::lerp(p, adsr.get_level_A0(), adsr.get_level_A1());
-        }
-        else if (math::in_range(t, t_ad, t_ds, Range::OpenClosed))
-        {
-          //std::cout << "D";
-          pl = math::value_to_param(t, t_ad, t_ds);
-          switch (adsr.get_shape_D())
-          {
-            case ADSRMode::LIN:
-              p = pl;
-              //env = math::linmap(t, t_ad, t_ds, 1.f, sustain_lvl);
-              break;
-            case ADSRMode::EXP:
-              p = 2 - 2*std::exp(-pl * math::c_ln2);
-              //env = (2 - 2.f*sustain_lvl)*std::exp(-math::c_ln2*(t - t_ad)/decay_s) - (1 - 2.f*sustain_lvl);
-              break;
-            case ADSRMode::LOG:
-              p = -std::log(1 - pl*(1 - math::c_1_e));
-              //env = std::log(1-(t - t_ad)/decay_s*(1.f-std::exp(sustain_lvl - 1))) + 1;
-              break;
-          }
-          env = math::lerp(p, adsr.get_level_D0(), adsr.get_level_D1());
-        }
-        else if (math::in_range(t, t_ds, t_sr, Range::OpenClosed))
-        {
-          //std::cout << "S";
-          env = adsr.get_level_S();
-        }
-        else if (math::in_range(t, t_sr, t_r, Range::OpenClosed))
-        {
-          //std::cout << "R";
-          pl = math::value_to_param(t, t_sr, t_r);
-          switch (adsr.get_shape_R())
-          {
-            case ADSRMode::LIN:
-              p = pl;
-              //env = math::linmap(t, t_sr, t_r, sustain_lvl, 0.f);
-              break;
-            case ADSRMode::EXP:
-              p = 2 - 2*std::exp(-pl * math::c_ln2);
-              //env = 2.f*sustain_lvl*std::exp(-static_cast<float>(M_LN2)*(t - t_sr)/release_s) - sustain_lvl;
-              break;
-            case ADSRMode::LOG:
-              p = -std::log(1 - pl*(1 - math::c_1_e));
-              //env = sustain_lvl*(static_cast<float>(std::log(1-(t - t_sr))/release_s*(1-1./static_cast<float>(M_E))) + 1);
-              break;
-          }
-          env = math::lerp(p, adsr.get_level_R0(), adsr.get_level_R1());
-        }
-        
-        //std::cout << env << ", ";
-        s *= env;
-      }
-      
-      output.update_duration();
+      apply_envelope_adsr(output, adsr, math_policy);
       return output;
     }
     
+    // In-place version of envelope_adsr().
+    static void apply_envelope_adsr(Waveform& wave, const ADSR& adsr,
+                                    MathPolicy math_policy = MathPolicy::PRECISE)
+    {
+      apply_envelope_adsr(wave.buffer, adsr, wave.duration, wave.sample_rate, math_policy);
+      wave.update_duration();
+    }
+    
+    static void apply_envelope_adsr(Waveform& wave,
+      const Attack& attack, const Decay& decay, const Sustain& sustain, const Release& release,
+      MathPolicy math_policy = MathPolicy::PRECISE)
+    {
+      ADSR adsr(attack, decay, sustain, release);
+      apply_envelope_adsr(wave, adsr, math_policy);
+    }
+    
+    // duration_s: The duration that the envelope is fitted to, normally that of the buffer.
+    static void apply_envelope_adsr(std::span<float> buffer, const ADSR& adsr, float duration_s, int sample_rate,
+                                    MathPolicy math_policy = MathPolicy::PRECISE)
+    {
+      EnvelopeGenerator env_gen(adsr, duration_s, sample_rate, buffer.size(), math_policy);
+      env_gen.apply(buffer);
+    }
+    
     static Waveform envelope_adsr(const Waveform& wave,
-      const Attack& attack, const Decay& decay, const Sustain& sustain, const Release& release)
+      const Attack& attack, const Decay& decay, const Sustain& sustain, const Release& release,
+      MathPolicy math_policy = MathPolicy::PRECISE)
     {
       ADSR adsr(attack, decay, sustain, release);
-      return envelope_adsr(wave, adsr);
+      return envelope_adsr(wave, adsr, math_policy);
     }
     
     static Waveform resample(const Waveform& wave, int new_sample_rate = 44100,
                              FilterType filter_type = FilterType::Butterworth,
                              int filter_order = 1, float cutoff_freq_multiplier = 2.5f, float ripple = 0.1f)
+    {
+      Waveform resampled_wave;
+      resample(wave, resampled_wave, new_sample_rate, filter_type, filter_order, cutoff_freq_multiplier, ripple);
+      return resampled_wave;
+    }
+    
+    // Writes the resampled waveform to resampled_wave, reusing its buffer.
+    // resampled_wave must not be wave unless the sample rates are equal.
+    static void resample(const Waveform& wave, Waveform& resampled_wave, int new_sample_rate = 44100,
+                         FilterType filter_type = FilterType::Butterworth,
+                         int filter_order = 1, float cutoff_freq_multiplier = 2.5f, float ripple = 0.1f)
     {
       if (wave.sample_rate == new_sample_rate)
-        return wave;
+      {
+        if (&resampled_wave != &wave)
+          resampled_wave = wave;
+        return;
+      }
       
-      Waveform resampled_wave;
       resampled_wave.copy_properties(wave);
       resampled_wave.sample_rate = new_sample_rate;
       
@@ -901,23 +943,78 @@ namespace beat
         float fraction = index_f - index;
         
         // Linear interpolation
-        resampled_wave.buffer[i] = (1.0f - fraction) * wave.buffer[index]
-        + fraction * wave.buffer[index + 1];
+        const size_t index_last = wave.buffer.size() - 1;
+        resampled_wave.buffer[i] = (1.0f - fraction) * wave.buffer[std::min(index, index_last)]
+        + fraction * wave.buffer[std::min(index + 1, index_last)];
       }
       
-      auto filtered_wave = filter(resampled_wave, filter_type, FilterOpType::LowPass,
+      apply_filter(resampled_wave, filter_type, FilterOpType::LowPass,
         filter_order, cutoff_freq_multiplier * wave.frequency, ripple, true);
       
-      filtered_wave.update_duration();
-      return filtered_wave;
+      resampled_wave.update_duration();
+    }
+    
+    // Polyphase windowed-sinc resampling via Resampler. Unlike the variants above it doesn't
+    // depend on wave.frequency, so it also suits loaded sounds, e.g. 48 kHz impulse responses.
+    static Waveform resample(const Waveform& wave, int new_sample_rate, ResamplerQuality quality)
+    {
+      Waveform resampled_wave;
+      resample(wave, resampled_wave, new_sample_rate, quality);
+      return resampled_wave;
+    }
+    
+    // Writes the resampled waveform to resampled_wave, reusing its buffer. resampled_wave may be wave.
+    static void resample(const Waveform& wave, Waveform& resampled_wave, int new_sample_rate, ResamplerQuality quality)
+    {
+      if (wave.sample_rate == new_sample_rate)
+      {
+        if (&resampled_wave != &wave)
+          resampled_wave = wave;
+        return;
+      }
+      
+      Resampler resampler(wave.sample_rate, new_sample_rate, quality);
+      std::vector<float> buffer_tmp;
+      auto& buffer = &resampled_wave == &wave ? buffer_tmp : resampled_wave.buffer;
+      buffer.clear();
+      buffer.reserve(resampler.num_out_total(wave.buffer.size()));
+      resampler.process(wave.buffer, buffer);
+      resampler.flush(buffer);
+      if (&resampled_wave == &wave)
+        resampled_wave.buffer.swap(buffer_tmp);
+      else
+        resampled_wave.copy_properties(wave);
+      resampled_wave.sample_rate = new_sample_rate;
+      resampled_wave.update_duration();
     }
     
     static Waveform filter(const Waveform& wave, const FilterArgs& args)
+    {
+      auto filtered_wave = wave;
+      apply_filter(filtered_wave, args);
+      return filtered_wave;
+    }
+    
+    static Waveform filter(const Waveform& wave,
+                           FilterType type,
+                           FilterOpType op_type,
+                           int filter_order,
+                           float freq_cutoff_hz, std::optional<float> freq_bandwidth_hz,
+                           float ripple = 0.1f, // ripple: For Chebychev filters.
+                           bool normalize_filtered_wave = false)
+    {
+      auto filtered_wave = wave;
+      apply_filter(filtered_wave, type, op_type, filter_order, freq_cutoff_hz, freq_bandwidth_hz, ripple, normalize_filtered_wave);
+      return filtered_wave;
+    }
+    
+    // In-place versions of the filter() functions.
+    static void apply_filter(Waveform& wave, const FilterArgs& args)
     {
       std::optional<float> bandwidth;
       if (args.bandwidth_freq_multiplier.has_value())
         bandwidth = args.bandwidth_freq_multiplier.value() * wave.frequency;
-      return filter(wave,
+      apply_filter(wave,
         args.filter_type,
         args.filter_op_type,
         args.filter_order,
@@ -927,43 +1024,127 @@ namespace beat
         args.normalize_filtered_wave);
     }
     
-    static Waveform filter(const Waveform& wave,
-                           FilterType type,
-                           FilterOpType op_type,
-                           int filter_order,
-                           float freq_cutoff_hz, std::optional<float> freq_bandwidth_hz,
-                           float ripple = 0.1f, // ripple: For Chebychev filters.
-                           bool normalize_filtered_wave = false)
+    static void apply_filter(Waveform& wave,
+                             FilterType type,
+                             FilterOpType op_type,
+                             int filter_order,
+                             float freq_cutoff_hz, std::optional<float> freq_bandwidth_hz,
+                             float ripple = 0.1f, // ripple: For Chebychev filters.
+                             bool normalize_filtered_wave = false)
     {
-      auto filtered_wave = wave;
+      if (type == FilterType::NONE)
+        return;
       
-      Filter flt;
+      auto flt = design_filter_sos(type, op_type, filter_order, freq_cutoff_hz, freq_bandwidth_hz, ripple, wave.sample_rate);
       
-      switch (type)
+      apply_filter(wave.buffer, flt);
+      
+      clamp(wave);
+      if (normalize_filtered_wave)
+        normalize(wave, true);
+    }
+    
+    static void apply_filter(std::span<float> x, const Filter& filter)
+    {
+      FilterProcessor(filter).process(x, x);
+    }
+    
+    static void apply_filter(std::span<float> x, const FilterSOS& filter)
+    {
+      FilterProcessor(filter).process(x, x);
+    }
+    
+    // Designs the filter via FilterDesignCache, so repeated designs with the same parameters are cheap.
+    static FilterSOS design_filter_sos(FilterType type,
+                                       FilterOpType op_type,
+                                       int filter_order,
+                                       float freq_cutoff_hz, std::optional<float> freq_bandwidth_hz,
+                                       float ripple, int sample_rate)
+    {
+      if (type == FilterType::Butterworth)
+        ripple = 0.f; // Not used. Don't let it split the cache entries.
+      FilterDesignKey key { type, op_type, filter_order, freq_cutoff_hz, freq_bandwidth_hz, ripple, sample_rate };
+      return FilterDesignCache::get(key, [&]()
       {
-        case FilterType::Butterworth:
-          flt = create_Butterworth_filter(filter_order, op_type, freq_cutoff_hz, freq_bandwidth_hz, wave.sample_rate);
-          break;
-          
-        case FilterType::ChebyshevTypeI:
-          flt = create_ChebyshevI_filter(filter_order, op_type, freq_cutoff_hz, freq_bandwidth_hz, ripple, wave.sample_rate);
-          break;
-          
-        case FilterType::ChebyshevTypeII:
-          flt = create_ChebyshevII_filter(filter_order, op_type, freq_cutoff_hz, freq_bandwidth_hz, ripple, wave.sample_rate);
-          break;
-          
-        default:
-          return wave;
+        switch (type)
+        {
+          case FilterType::Butterworth:
+            return create_Butterworth_filter_sos(filter_order, op_type, freq_cutoff_hz, freq_bandwidth_hz, sample_rate);
+          case FilterType::ChebyshevTypeI:
+            return create_ChebyshevI_filter_sos(filter_order, op_type, freq_cutoff_hz, freq_bandwidth_hz, ripple, sample_rate);
+          case FilterType::ChebyshevTypeII:
+            return create_ChebyshevII_filter_sos(filter_order, op_type, freq_cutoff_hz, freq_bandwidth_hz, ripple, sample_rate);
+          default:
+            return FilterSOS {};
+        }
+      });
+    }
+    
+    // The filter that apply_filter(wave, args) uses for a waveform of this frequency and sample rate.
+    static FilterSOS design_filter_sos(const FilterArgs& args, float frequency, int sample_rate)
+    {
+      std::optional<float> bandwidth;
+      if (args.bandwidth_freq_multiplier.has_value())
+        bandwidth = args.bandwidth_freq_multiplier.value() * frequency;
+      return design_filter_sos(args.filter_type, args.filter_op_type, args.filter_order,
+                               args.cutoff_freq_multiplier * frequency, bandwidth,
+                               args.ripple, sample_rate);
+    }
+    
+    // Filters the waveforms, e.g. channels or voices, each with its frequency and sample rate
+    // and running up to MultiLaneFilterProcessor::c_max_lanes of them side by side in SIMD lanes.
+    static std::vector<Waveform> filter(const std::vector<Waveform>& waves, const FilterArgs& args)
+    {
+      auto filtered_waves = waves;
+      std::vector<std::pair<Waveform*, const FilterArgs*>> jobs;
+      for (auto& wave : filtered_waves)
+        jobs.emplace_back(&wave, &args);
+      filter_multi_lane(jobs);
+      return filtered_waves;
+    }
+    
+    // Filters each waveform in place with its own FilterArgs. Same result as filter(wave, args) per waveform.
+    static void filter_multi_lane(const std::vector<std::pair<Waveform*, const FilterArgs*>>& jobs)
+    {
+      struct Lane
+      {
+        Waveform* wave = nullptr;
+        const FilterArgs* args = nullptr;
+        FilterSOS sos;
+      };
+      std::vector<Lane> lanes;
+      for (const auto& [wave, args] : jobs)
+      {
+        if (wave == nullptr || args == nullptr || args->filter_type == FilterType::NONE)
+          continue;
+        lanes.push_back({ wave, args, design_filter_sos(*args, wave->frequency, wave->sample_rate) });
       }
+      // Similar lengths in the same batch means less zero padding.
+      std::stable_sort(lanes.begin(), lanes.end(),
+                       [](const Lane& a, const Lane& b) { return a.wave->buffer.size() > b.wave->buffer.size(); });
       
-      filtered_wave.buffer = filter(wave.buffer, flt);
-      
-      clamp(filtered_wave);
-      if (normalize_filtered_wave)
-        normalize(filtered_wave, true);
+      const int num_lanes_max = MultiLaneFilterProcessor::c_max_lanes;
+      for (size_t start = 0; start < lanes.size(); start += num_lanes_max)
+      {
+        const size_t end = std::min(lanes.size(), start + num_lanes_max);
+        std::vector<FilterSOS> filters;
+        std::vector<std::span<float>> buffers;
+        for (size_t i = start; i < end; ++i)
+        {
+          filters.emplace_back(lanes[i].sos);
+          buffers.emplace_back(lanes[i].wave->buffer);
+        }
+        std::vector<std::span<const float>> in(buffers.begin(), buffers.end());
+        MultiLaneFilterProcessor proc(filters);
+        proc.process(in, buffers);
+      }
       
-      return filtered_wave;
+      for (auto& lane : lanes)
+      {
+        clamp(*lane.wave);
+        if (lane.args->normalize_filtered_wave)
+          normalize(*lane.wave, true);
+      }
     }
     
     static Waveform filter(const Waveform& wave,
@@ -977,57 +1158,63 @@ namespace beat
     static std::vector<float> filter(const std::vector<float>& x,
                                      const Filter& filter)
     {
-      size_t Ns = x.size();
-      size_t Na = filter.a.size();
-      size_t Nb = filter.b.size();
-      
-      std::vector<float> y(Ns, 0);
-      
-      // Apply the filter (Direct Form I)
-      for (size_t n = 0; n < Ns; ++n)
-      {
-        y[n] = 0;
-        
-        // Summing the b terms
-        for (size_t i = 0; i < Nb; i++)
-        {
-          if (n >= i)
-            y[n] += filter.b[i] * x[n - i];
-        }
-        
-        // Subtracting the a terms
-        for (size_t i = 1; i < Na; i++)
-        {
-          if (n >= i)
-            y[n] -= filter.a[i] * y[n - i];
-        }
-        
-        y[n] /= filter.a[0];  // Normalize output
-      }
-      
+      std::vector<float> y(x.size(), 0.f);
+      FilterProcessor(filter).process(x, y);
+      return y;
+    }
+    
+    static Waveform filter(const Waveform& wave,
+                           const FilterSOS& filter)
+    {
+      Waveform ret = wave;
+      ret.buffer = WaveformHelper::filter(wave.buffer, filter);
+      return ret;
+    }
+    
+    // Cascade of transposed direct form II biquads, one pass over the signal per section.
+    static std::vector<float> filter(const std::vector<float>& x,
+                                     const FilterSOS& filter)
+    {
+      std::vector<float> y = x;
+      FilterProcessor(filter).process(y, y);
       return y;
     }
     
+    // Transfer function polynomials b and a. Prefer create_Butterworth_filter_sos() for higher orders.
     static Filter create_Butterworth_filter(int order,
                                             FilterOpType type,
                                             float freq_cutoff, std::optional<float> freq_bandwidth,
                                             int sample_rate = 44100)
     {
-      Filter flt;
-      
+      return zpk2tf(create_Butterworth_zpk(order, type, freq_cutoff, freq_bandwidth, sample_rate));
+    }
+    
+    static FilterSOS create_Butterworth_filter_sos(int order,
+                                                   FilterOpType type,
+                                                   float freq_cutoff, std::optional<float> freq_bandwidth,
+                                                   int sample_rate = 44100)
+    {
+      return zpk2sos(create_Butterworth_zpk(order, type, freq_cutoff, freq_bandwidth, sample_rate));
+    }
+    
+    static std::optional<FilterS> create_Butterworth_zpk(int order,
+                                                         FilterOpType type,
+                                                         float freq_cutoff, std::optional<float> freq_bandwidth,
+                                                         int sample_rate = 44100)
+    {
       if (type == FilterOpType::NONE)
-        return flt;
+        return std::nullopt;
       
       if (order <= 0)
       {
         std::cerr << "The order of the Butterworth filter must be at least 1!" << std::endl;
-        return flt;
+        return std::nullopt;
       }
       
       if ((type == FilterOpType::BandPass || type == FilterOpType::BandStop) && !freq_bandwidth.has_value())
       {
         std::cerr << "freq_bandwidth must be specified when creating a BandPass or BandStop filter!" << std::endl;
-        return flt;
+        return std::nullopt;
       }
       
       std::vector<double> W_cutoff;
@@ -1067,33 +1254,47 @@ namespace beat
       
       bilinear(s, fs2);
       
-      flt.b = stlutils::static_cast_vector<float>(stlutils::mult_scalar(poly(s.zeroes), s.gain));
-      flt.a = stlutils::static_cast_vector<float>(poly(s.poles));
-      
-      return flt;
+      return s;
     }
     
+    // Transfer function polynomials b and a. Prefer create_ChebyshevI_filter_sos() for higher orders.
     static Filter create_ChebyshevI_filter(int order,
                                            FilterOpType type,
                                            float freq_cutoff, std::optional<float> freq_bandwidth,
                                            float ripple,
                                            int sample_rate = 44100)
     {
-      Filter flt;
-      
+      return zpk2tf(create_ChebyshevI_zpk(order, type, freq_cutoff, freq_bandwidth, ripple, sample_rate));
+    }
+    
+    static FilterSOS create_ChebyshevI_filter_sos(int order,
+                                                  FilterOpType type,
+                                                  float freq_cutoff, std::optional<float> freq_bandwidth,
+                                                  float ripple,
+                                                  int sample_rate = 44100)
+    {
+      return zpk2sos(create_ChebyshevI_zpk(order, type, freq_cutoff, freq_bandwidth, ripple, sample_rate));
+    }
+    
+    static std::optional<FilterS> create_ChebyshevI_zpk(int order,
+                                                        FilterOpType type,
+                                                        float freq_cutoff, std::optional<float> freq_bandwidth,
+                                                        float ripple,
+                                                        int sample_rate = 44100)
+    {
       if (type == FilterOpType::NONE)
-        return flt;
+        return std::nullopt;
       
       if (order <= 0)
       {
         std::cerr << "The order of the Chebyshev type I filter must be at least 1!" << std::endl;
-        return flt;
+        return std::nullopt;
       }
       
       if ((type == FilterOpType::BandPass || type == FilterOpType::BandStop) && !freq_bandwidth.has_value())
       {
         std::cerr << "freq_bandwidth must be specified when creating a BandPass or BandStop filter!" << std::endl;
-        return flt;
+        return std::nullopt;
       }
       
       std::vector<double> W_cutoff;
@@ -1137,33 +1338,47 @@ namespace beat
       
       bilinear(s, fs2);
       
-      flt.b = stlutils::static_cast_vector<float>(stlutils::mult_scalar(poly(s.zeroes), s.gain));
-      flt.a = stlutils::static_cast_vector<float>(poly(s.poles));
-      
-      return flt;      
+      return s;
     }
     
+    // Transfer function polynomials b and a. Prefer create_ChebyshevII_filter_sos() for higher orders.
     static Filter create_ChebyshevII_filter(int order,
                                             FilterOpType type,
                                             float freq_cutoff, std::optional<float> freq_bandwidth,
                                             float ripple,
                                             int sample_rate = 44100)
     {
-      Filter flt;
-      
+      return zpk2tf(create_ChebyshevII_zpk(order, type, freq_cutoff, freq_bandwidth, ripple, sample_rate));
+    }
+    
+    static FilterSOS create_ChebyshevII_filter_sos(int order,
+                                                   FilterOpType type,
+                                                   float freq_cutoff, std::optional<float> freq_bandwidth,
+                                                   float ripple,
+                                                   int sample_rate = 44100)
+    {
+      return zpk2sos(create_ChebyshevII_zpk(order, type, freq_cutoff, freq_bandwidth, ripple, sample_rate));
+    }
+    
+    static std::optional<FilterS> create_ChebyshevII_zpk(int order,
+                                                         FilterOpType type,
+                                                         float freq_cutoff, std::optional<float> freq_bandwidth,
+                                                         float ripple,
+                                                         int sample_rate = 44100)
+    {
       if (type == FilterOpType::NONE)
-        return flt;
+        return std::nullopt;
       
       if (order <= 0)
       {
         std::cerr << "The order of the Chebyshev type I filter must be at least 1!" << std::endl;
-        return flt;
+        return std::nullopt;
       }
       
       if ((type == FilterOpType::BandPass || type == FilterOpType::BandStop) && !freq_bandwidth.has_value())
       {
         std::cerr << "freq_bandwidth must be specified when creating a BandPass or BandStop filter!" << std::endl;
-        return flt;
+        return std::nullopt;
       }
       
       std::vector<double> W_cutoff;
@@ -1213,7 +1428,7 @@ namespace beat
         else
         {
           std::cerr << "ERROR in create_ChebyshevII_filter() : Unable to calculate zeroes!" << std::endl;
-          return flt;
+          return std::nullopt;
         }
       }
       
@@ -1223,10 +1438,7 @@ namespace beat
       
       bilinear(s, fs2);
       
-      flt.b = stlutils::static_cast_vector<float>(stlutils::mult_scalar(poly(s.zeroes), s.gain));
-      flt.a = stlutils::static_cast_vector<float>(poly(s.poles));
-      
-      return flt;      
+      return s;
     }
     
     
@@ -1386,66 +1598,6 @@ namespace beat
       return gcd_result;
     }
     
-    static std::vector<std::complex<float>> fft_rec(const std::vector<std::complex<float>>& x)
-    {
-      auto N = x.size();
-      
-      if (N == 1)
-        return x;
-        
-      auto Nh = static_cast<size_t>(N/2);
-        
-      std::vector<std::complex<float>> x_even(Nh), x_odd(Nh), y(N, 0.f);
-      for (size_t i = 0; i < Nh; ++i)
-      {
-        x_even[i] = x[2*i];
-        x_odd[i] = x[2*i + 1];
-      }
-      
-      auto y_even = fft_rec(x_even);
-      auto y_odd = fft_rec(x_odd);
-      
-      for (size_t m = 0; m < N; ++m)
-      {
-        auto m_alias = m % Nh;
-        auto w_m = std::exp(-2.if * static_cast<float>(math::c_pi * m) / static_cast<float>(N));
-        y[m] = y_even[m_alias] + w_m * y_odd[m_alias];
-      }
-      
-      return y;
-    }
-    
-    static std::vector<std::complex<float>> ifft_rec(const std::vector<std::complex<float>>& x)
-    {
-      auto N = x.size();
-      
-      if (N == 1)
-        return x;
-        
-      auto Nh = static_cast<size_t>(N/2);
-        
-      std::vector<std::complex<float>> x_even(Nh), x_odd(Nh), y(N, 0.f);
-      for (size_t i = 0; i < Nh; ++i)
-      {
-        x_even[i] = x[2*i];
-        x_odd[i] = x[2*i + 1];
-      }
-      
-      auto y_even = ifft_rec(x_even);
-      auto y_odd = ifft_rec(x_odd);
-      
-      for (size_t m = 0; m < N; ++m)
-      {
-        auto m_alias = m % Nh;
-        auto w_m = std::exp(2.if * static_cast<float>(math::c_pi * m) / static_cast<float>(N));
-        y[m] = y_even[m_alias] + w_m * y_odd[m_alias];
-        //y[m] = (y_even[m_alias] + w_m * y_odd[m_alias])/static_cast<float>(N);
-        //y[m] = (y_even[m_alias] + w_m * y_odd[m_alias])/static_cast<float>(Nh);
-      }
-      
-      return y;
-    }
-    
     // Assuming 'signal' is your time-domain signal before FFT or after IFFT.
     static void apply_window(Waveform& wave, WindowType type)
     {
@@ -1471,10 +1623,11 @@ namespace beat
     }
     
     // Inspired by flanger from https://github.com/abaga129/lib_dsp .
-    static std::vector<float> flanger(const std::vector<float>& x, float delay_time, float lfo_freq, float feedback, int Fs)
+    // x and y may be the same buffer.
+    static void flanger(std::span<const float> x, std::span<float> y, float delay_time, float lfo_freq, float feedback, int Fs,
+                        MathPolicy math_policy)
     {
-      size_t N = x.size();
-      std::vector<float> y(N, 0);
+      size_t N = std::min(x.size(), y.size());
       
       auto D = static_cast<int>(std::round(delay_time*Fs));
       std::vector<float> xd(D + 1, 0);
@@ -1484,32 +1637,46 @@ namespace beat
       // Calculate fade in/out lengths (10% of delay time)
       size_t fade_length = static_cast<size_t>(0.1 * D);
       
-      for (size_t n = 0; n < N; ++n)
+      // The LFO is evaluated one block at a time.
+      constexpr size_t c_lfo_block_size = 256;
+      std::array<float, c_lfo_block_size> lfo;
+      for (size_t n0 = 0; n0 < N; n0 += c_lfo_block_size)
       {
-        float t = static_cast<float>(n)/Fs;
-        int d = static_cast<int>(std::round(0.5f*D*std::sin(math::c_2pi * lfo_freq * t)));
-        int tap_idx = q + d;
-        if (tap_idx < 0)
-          tap_idx += D + 1;
-        if (tap_idx >= D + 1)
-          tap_idx -= D + 1;
+        const size_t len = std::min(c_lfo_block_size, N - n0);
+        for (size_t k = 0; k < len; ++k)
+        {
+          float t = static_cast<float>(n0 + k)/Fs;
+          lfo[k] = math::c_2pi * lfo_freq * t;
+        }
+        auto lfo_block = std::span<float>(lfo).first(len);
+        FastMath::sin(lfo_block, lfo_block, math_policy);
         
-        // Apply crossfade at the start and end of the buffer
-        float fade_in = 1.0f;
-        float fade_out = 1.0f;
-        if (n < fade_length)
-          fade_in = static_cast<float>(n) / fade_length;
-        if (n > N - fade_length)
-          fade_out = static_cast<float>(N - n) / fade_length;
-
-        y[n] = (1.f - feedback) * x[n] * fade_in + feedback * xd[tap_idx] * fade_out;
-        xd[q] = x[n];
-        q--;
-        if (q < 0)
-          q = D;
+        for (size_t k = 0; k < len; ++k)
+        {
+          const size_t n = n0 + k;
+          int d = static_cast<int>(std::round(0.5f*D*lfo[k]));
+          int tap_idx = q + d;
+          if (tap_idx < 0)
+            tap_idx += D + 1;
+          if (tap_idx >= D + 1)
+            tap_idx -= D + 1;
+          
+          // Apply crossfade at the start and end of the buffer
+          float fade_in = 1.0f;
+          float fade_out = 1.0f;
+          if (n < fade_length)
+            fade_in = static_cast<float>(n) / fade_length;
+          if (n > N - fade_length)
+            fade_out = static_cast<float>(N - n) / fade_length;
+          
+          const float xn = x[n];
+          y[n] = (1.f - feedback) * xn * fade_in + feedback * xd[tap_idx] * fade_out;
+          xd[q] = xn;
+          q--;
+          if (q < 0)
+            q = D;
+        }
       }
-      
-      return y;
     }
     
     static FilterS filter_edge_adjustment(const FilterS& s, FilterOpType type, double Wl, double Wh)
@@ -1668,6 +1835,90 @@ namespace beat
       }
     }
     
+    static Filter zpk2tf(const std::optional<FilterS>& zpk)
+    {
+      Filter flt;
+      if (!zpk.has_value())
+        return flt;
+      const auto& s = zpk.value();
+      flt.b = stlutils::static_cast_vector<float>(stlutils::mult_scalar(poly(s.zeroes), s.gain));
+      flt.a = stlutils::static_cast_vector<float>(poly(s.poles));
+      return flt;
+    }
+    
+    // Groups the poles and zeroes into real second-order sections.
+    // Each pole pair gets the zero pair closest to it and the sections are ordered
+    // with the poles closest to the unit circle last. The gain goes into the first section.
+    static FilterSOS zpk2sos(const std::optional<FilterS>& zpk)
+    {
+      FilterSOS sos;
+      if (!zpk.has_value())
+        return sos;
+      const auto& s = zpk.value();
+      
+      // Quadratic factor 1 + c1 z^-1 + c2 z^-2 from a complex conjugate pair or two real roots.
+      struct Quad
+      {
+        double c1 = 0.;
+        double c2 = 0.;
+        std::complex<double> root;
+      };
+      auto f_quads = [](const std::vector<std::complex<double>>& roots)
+      {
+        std::vector<Quad> quads;
+        std::vector<double> reals;
+        for (const auto& r : roots)
+        {
+          if (std::abs(r.imag()) <= 1e-6 * std::max(1., std::abs(r)))
+            reals.emplace_back(r.real());
+          else if (r.imag() > 0.) // The conjugate is implied.
+            quads.push_back({ -2. * r.real(), std::norm(r), r });
+        }
+        std::sort(reals.begin(), reals.end(), [](double a, double b) { return std::abs(a) > std::abs(b); });
+        for (size_t i = 0; i + 1 < reals.size(); i += 2)
+          quads.push_back({ -(reals[i] + reals[i + 1]), reals[i] * reals[i + 1], reals[i] });
+        if (reals.size() % 2 == 1)
+          quads.push_back({ -reals.back(), 0., reals.back() });
+        return quads;
+      };
+      auto pole_quads = f_quads(s.poles);
+      auto zero_quads = f_quads(s.zeroes);
+      std::sort(pole_quads.begin(), pole_quads.end(),
+                [](const Quad& a, const Quad& b) { return std::abs(a.root) > std::abs(b.root); });
+      
+      std::vector<bool> zero_used(zero_quads.size(), false);
+      for (const auto& pq : pole_quads)
+      {
+        Biquad sec;
+        sec.a1 = static_cast<float>(pq.c1);
+        sec.a2 = static_cast<float>(pq.c2);
+        int best_idx = -1;
+        for (int i = 0; i < static_cast<int>(zero_quads.size()); ++i)
+          if (!zero_used[i] && (best_idx == -1 || std::abs(zero_quads[i].root - pq.root) < std::abs(zero_quads[best_idx].root - pq.root)))
+            best_idx = i;
+        if (best_idx >= 0)
+        {
+          zero_used[best_idx] = true;
+          sec.b1 = static_cast<float>(zero_quads[best_idx].c1);
+          sec.b2 = static_cast<float>(zero_quads[best_idx].c2);
+        }
+        sos.sections.emplace_back(sec);
+      }
+      for (int i = 0; i < static_cast<int>(zero_quads.size()); ++i)
+        if (!zero_used[i])
+          sos.sections.push_back({ 1.f, static_cast<float>(zero_quads[i].c1), static_cast<float>(zero_quads[i].c2), 0.f, 0.f });
+      
+      std::reverse(sos.sections.begin(), sos.sections.end());
+      if (sos.sections.empty())
+        sos.sections.emplace_back();
+      auto& first = sos.sections.front();
+      const auto gain = static_cast<float>(s.gain);
+      first.b0 *= gain;
+      first.b1 *= gain;
+      first.b2 *= gain;
+      return sos;
+    }
+    
     static std::vector<double> poly(const std::vector<std::complex<double>>& roots)
     {
       std::vector<std::complex<double>> y = { 1. };
@@ -0,0 +1,117 @@
+//
+//  Wavetable.h
+//  8Beat
+//
+//  Created by Rasmus Anthin on 2026-10-17.
+//
+
+#pragma once
+
+#include "WaveformHelper.h"
+#include <Core/MathUtils.h>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <vector>
+
+
+namespace beat
+{
+
+  // Band-limited wavetable of one waveform cycle with one mip level per octave.
+  // Level l only holds the harmonics up to (c_table_size / 2) >> l so that the table
+  // can be played back at high frequencies without aliasing.
+  // Read via a 32-bit fixed-point phase accumulator (a full cycle is 2^32)
+  // with linear interpolation between the table samples.
+  class Wavetable
+  {
+  public:
+    static constexpr int c_table_bits = 11;
+    static constexpr int c_table_size = 1 << c_table_bits;
+    static constexpr int c_num_levels = c_table_bits;
+    
+    // cycle: c_table_size samples of one cycle of the waveform, phi in [0, 2pi).
+    explicit Wavetable(std::span<const float> cycle)
+      : m_tables(c_num_levels * c_stride, 0.f)
+    {
+      if (cycle.size() != c_table_size)
+      {
+        std::cerr << "ERROR in Wavetable() : cycle must be " << c_table_size << " samples long!" << std::endl;
+        return;
+      }
+      
+      Waveform wave;
+      wave.buffer.assign(cycle.begin(), cycle.end());
+      wave.sample_rate = c_table_size;
+      auto spectrum = WaveformHelper::fft(wave, true);
+      
+      Spectrum level_spectrum;
+      level_spectrum.copy_properties(spectrum);
+      for (int l = 0; l < c_num_levels; ++l)
+      {
+        // The Nyquist bin is always dropped.
+        const int max_harmonic = std::min((c_table_size / 2) >> l, c_table_size / 2 - 1);
+        level_spectrum.buffer = spectrum.buffer;
+        for (int k = max_harmonic + 1; k <= c_table_size / 2; ++k)
+          level_spectrum.buffer[k] = 0.f;
+        auto level_wave = WaveformHelper::ifft(level_spectrum);
+        
+        float* table = &m_tables[l * c_stride];
+        for (int i = 0; i < c_table_size; ++i)
+          table[i] = level_wave.buffer[i];
+        table[c_table_size] = table[0]; // Guard sample for the interpolation.
+      }
+    }
+    
+    // Mip level with no harmonics above the Nyquist frequency at this playback frequency.
+    static int select_level(float freq, int sample_rate)
+    {
+      // Level l is alias-free as long as freq * (c_table_size >> l) <= sample_rate.
+      float x = std::abs(freq) * c_table_size / sample_rate;
+      if (x <= 1.f)
+        return 0;
+      int ex = 0;
+      float m = std::frexp(x, &ex);
+      int level = m == 0.5f ? ex - 1 : ex;
+      return std::min(level, c_num_levels - 1);
+    }
+    
+    static uint32_t phase_increment(float freq, int sample_rate)
+    {
+      return static_cast<uint32_t>(static_cast<int64_t>(static_cast<double>(freq) * c_phase_scale / sample_rate));
+    }
+    
+    // phi in radians.
+    static uint32_t phase_offset(float phi)
+    {
+      auto cycles = static_cast<double>(phi) / math::c_2pi;
+      return static_cast<uint32_t>(static_cast<int64_t>(std::llround((cycles - std::floor(cycles)) * c_phase_scale)));
+    }
+    
+    float lookup(uint32_t phase, int level) const
+    {
+      const float* table = &m_tables[level * c_stride];
+      const uint32_t idx = phase >> c_frac_bits;
+      const float frac = static_cast<float>(phase & c_frac_mask) * (1.f / (1u << c_frac_bits));
+      const float a = table[idx];
+      const float b = table[idx + 1];
+      return a + frac*(b - a);
+    }
+    
+    // Table for the mip level, c_table_size samples.
+    std::span<const float> get_level(int level) const
+    {
+      return { &m_tables[level * c_stride], static_cast<size_t>(c_table_size) };
+    }
+  
+  private:
+    static constexpr int c_stride = c_table_size + 1;
+    static constexpr int c_frac_bits = 32 - c_table_bits;
+    static constexpr uint32_t c_frac_mask = (1u << c_frac_bits) - 1;
+    static constexpr double c_phase_scale = 4294967296.0; // 2^32.
+    
+    std::vector<float> m_tables;
+  };
+  
+}
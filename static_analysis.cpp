@@ -2,6 +2,15 @@
 #include "AudioSourceHandler.h"
 #include "ChipTuneEngine.h"
 #include "ChipTuneEngine_Internals/ChipTuneEngineParser.h"
+#include "Convolver.h"
+#include "EffectChain.h"
+#include "EnvelopeGenerator.h"
+#include "FFT.h"
+#include "FastMath.h"
+#include "FilterProcessor.h"
+#include "MixBus.h"
+#include "PRNG.h"
+#include "Resampler.h"
 #include "SFX.h"
 #include "Spectrum.h"
 #include "Synthesizer.h"
@@ -9,3 +18,4 @@
 #include "WaveformGeneration.h"
 #include "WaveformHelper.h"
 #include "WaveformIO.h"
+#include "Wavetable.h"